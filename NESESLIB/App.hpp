@@ -1,15 +1,29 @@
 #pragma once
 #include <iostream>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <string>
 #include "BackObject.hpp"
 #include "ThreadManager.hpp"
 #include "TaskPool.hpp"
+#include "TaskStrand.hpp"
+#include "ConfigManager.hpp"
+#include "NesesString.hpp"
 
 namespace NESES
 {
 	constexpr size_t maxthreadcount = 4;
 	constexpr size_t maxconcurrenttaskcount = 16;
 
+	// well known executor lanes, any other name can be configured as well
+	namespace Lane
+	{
+		constexpr const char* cpu = "cpu";				// default pool, cpu bound work
+		constexpr const char* io = "io";				// blocking file / network io
+		constexpr const char* latency = "latency";		// short, latency sensitive tasks
+	}
+
 	
 	class AppImplBase 
 	{
@@ -26,6 +40,8 @@ namespace NESES
 		std::unique_ptr<AppImplBase> impl;
 		ThreadManager<NesesThread> tm;
 		TaskPool<BackObject> tpool;
+		std::map<std::string, std::unique_ptr<TaskPool<BackObject>>> lanes;	// named executors besides tpool
+		std::mutex laneLock;
 
 		Application()
 			:tm(maxthreadcount)
@@ -69,6 +85,58 @@ namespace NESES
 				impl->init();
 		}
 
+		/*
+		reads executor and thread limits from the config file, read the config (ConfigManager::ReadConfigFile) first
+		<THREADS><maxCount>8</maxCount></THREADS>
+		<EXECUTORS>
+			<io><workers>8</workers><queue>256</queue></io>
+			<latency><workers>2</workers><queue>64</queue></latency>
+		</EXECUTORS>
+		workers 0 means one per core, the cpu lane is the default pool and cannot be reconfigured
+		*/
+		void ConfigureExecutors()
+		{
+			int maxthreads = StringUtil::ParseInteger(ConfigManager::GetValue("CONFIG.THREADS.maxCount"), 0);
+			if (maxthreads > 0)
+				tm.SetMaxWorkerCount(static_cast<size_t>(maxthreads));
+
+			for (const auto& lane : ConfigManager::GetChildNames("CONFIG.EXECUTORS"))
+			{
+				std::string path = "CONFIG.EXECUTORS." + lane;
+				int workers = StringUtil::ParseInteger(ConfigManager::GetValue(path + ".workers"), 0);
+				int queue = StringUtil::ParseInteger(ConfigManager::GetValue(path + ".queue"), static_cast<int>(maxconcurrenttaskcount));
+				if (workers < 0 || queue <= 0 || !AddExecutor(lane, workers, queue))
+					std::cerr << "Executor " << lane << " not configured" << std::endl;
+			}
+		}
+
+		// adds a named executor with its own workers and queue limit, false if the name is taken
+		bool AddExecutor(const std::string& lane, size_t workercount, size_t maxtaskcount)
+		{
+			if (lane.empty() || lane == Lane::cpu) return false;
+			std::lock_guard<std::mutex> lock(laneLock);
+			if (lanes.count(lane) > 0) return false;
+			lanes.emplace(lane, std::make_unique<TaskPool<BackObject>>(maxtaskcount, workercount));
+			return true;
+		}
+
+		// executor for lane, unknown lanes fall back to the default (cpu) pool
+		TaskPool<BackObject>& GetExecutor(const std::string& lane)
+		{
+			std::lock_guard<std::mutex> lock(laneLock);
+			auto it = lanes.find(lane);
+			if (it == lanes.end())
+				return tpool;
+			return *(it->second);
+		}
+
+		bool HasExecutor(const std::string& lane)
+		{
+			if (lane == Lane::cpu) return true;
+			std::lock_guard<std::mutex> lock(laneLock);
+			return lanes.count(lane) > 0;
+		}
+
 		std::shared_ptr<NesesThread> NewWorker(const std::string& name = "")
 		{
 			return tm.GetNew(name);
@@ -79,12 +147,29 @@ namespace NESES
 			return tpool.GetNew(name);
 		}
 
+		// ordered, non-overlapping execution on the shared task pool
+		std::shared_ptr<TaskStrand<BackObject>> NewStrand(const std::string& name = "", size_t maxtaskcount = 0)
+		{
+			return tpool.NewStrand(name, maxtaskcount);
+		}
+
+		std::shared_ptr<TaskStrand<BackObject>> NewStrand(const std::string& name, const std::string& lane, size_t maxtaskcount = 0)
+		{
+			return GetExecutor(lane).NewStrand(name, maxtaskcount);
+		}
+
 		// task starts when you enqueue, dont forget to set and get future before enqueuing if you need
 		bool EnqueueTask(std::shared_ptr<NesesTask<BackObject>> task)
 		{
 			return tpool.Enqueue(task);
 		}
 
+		// route the task to a named executor, e.g. Lane::io for blocking IOUtil copies
+		bool EnqueueTask(std::shared_ptr<NesesTask<BackObject>> task, const std::string& lane)
+		{
+			return GetExecutor(lane).Enqueue(task);
+		}
+
 		void StopWorkers()
 		{
 			tm.StopAll();
@@ -93,10 +178,11 @@ namespace NESES
 		void StopTasks()
 		{
 			tpool.StopAll();
+			std::lock_guard<std::mutex> lock(laneLock);
+			for (auto& lane : lanes)
+				lane.second->StopAll();
 		}
 	};
 
 	using App = Application;
 }// namespace NESES
-
-
@@ -1,10 +1,97 @@
 #pragma once
 #include<functional>
+#include<memory>
+#include<atomic>
+#include<mutex>
+#include<thread>
+#include<vector>
+#include<cstdint>
+#include "InlineFunction.hpp"
 
 
 namespace NESES
 {   
+// One immutable value published to many readers without a lock on the read side (RCU like).
+// A reader counts itself in the counter of the current phase and uses the pointer it loaded.
+// A writer swaps the pointer, then flips the phase twice, each time waiting until the readers of
+// the previous phase are out, and frees the replaced value: setCallback waits for the invokes
+// already running, never for new ones. A write from inside a read on the same thread cannot wait,
+// that value is freed by a later write or the destructor. Writers are serialized by writeLock.
+template <typename T>
+class PublishedValue {
+public:
+    PublishedValue() = default;
+    PublishedValue(const PublishedValue&) = delete;
+    PublishedValue& operator=(const PublishedValue&) = delete;
+
+    ~PublishedValue() {
+        delete current.load();
+        for (T* p : retired)
+            delete p;
+    }
+
+    // f gets the current value or nullptr, the value stays alive until f returns
+    template <typename F>
+    decltype(auto) read(F&& f) const {
+        Reader reader(readers[phase.load() & 1]);
+        return f(static_cast<const T*>(current.load()));
+    }
+
+    // takes ownership of next, nullptr clears
+    void store(T* next) {
+        std::lock_guard<std::mutex> lock(writeLock);
+        publish(next);
+    }
+
+    // modify(copy) builds the next value from a copy of the current one (T() when empty); false keeps the current
+    template <typename Modifier>
+    bool update(Modifier&& modify) {
+        std::lock_guard<std::mutex> lock(writeLock);
+        T* now = current.load();
+        T* next = now ? new T(*now) : new T();
+        if (!modify(*next)) {
+            delete next;
+            return false;
+        }
+        publish(next);
+        return true;
+    }
+
+private:
+    struct Reader {
+        std::atomic<std::size_t>& count;
+        explicit Reader(std::atomic<std::size_t>& c) : count(c) { count.fetch_add(1); readDepth++; }
+        ~Reader() { readDepth--; count.fetch_sub(1); }
+    };
+
+    // under writeLock; seq_cst everywhere: a reader counted after a phase was seen empty loads the new pointer
+    void publish(T* next) {
+        T* old = current.exchange(next);
+        if (old)
+            retired.push_back(old);
+        if (readDepth > 0)
+            return;
+        for (int i = 0; i < 2; i++) {
+            std::size_t previous = phase.fetch_add(1);
+            while (readers[previous & 1].load() != 0)
+                std::this_thread::yield();
+        }
+        for (T* p : retired)
+            delete p;
+        retired.clear();
+    }
+
+    static inline thread_local int readDepth{ 0 };     // reads in progress on this thread
+    std::atomic<T*> current{ nullptr };
+    mutable std::atomic<std::size_t> phase{ 0 };
+    mutable std::atomic<std::size_t> readers[2]{};
+    std::vector<T*> retired;        // under writeLock
+    std::mutex writeLock;
+};
+
 // Callback class with variadic arguments
+// setCallback may run while another thread is inside invoke: the invoker keeps using the
+// callable it loaded, the read side takes no lock (see PublishedValue).
 template <typename... Args>
 class CallBack {
 public:
@@ -14,25 +101,133 @@ public:
     // Constructor
     CallBack() = default;
 
+    // copies get their own copy of the callable
+    CallBack(const CallBack& other) {
+        copyFrom(other);
+    }
+
+    CallBack& operator=(const CallBack& other) {
+        if (this != &other)
+            copyFrom(other);
+        return *this;
+    }
+
     // Set the callback function, taking it by const reference
     void setCallback(const CallbackFunction& cb) {
-        callback = cb;
+        callback.store(cb ? new CallbackFunction(cb) : nullptr);
     }
 
     // Alternatively, use an rvalue reference to move the callback function
     void setCallback(CallbackFunction&& cb) {
-        callback = std::move(cb);
+        callback.store(cb ? new CallbackFunction(std::move(cb)) : nullptr);
     }
-    // Invoke the callback function
-    void invoke(Args... args) {
-        if (callback) {
-            callback(std::forward<Args>(args)...);
-        }
+
+    // Invoke the callback function, arguments are forwarded as given (no extra copy here)
+    template <typename... CallArgs>
+    void invoke(CallArgs&&... args) const {
+        callback.read([&](const CallbackFunction* cb) {
+            if (cb) {
+                (*cb)(std::forward<CallArgs>(args)...);
+            }
+        });
+    }
+
+    bool isSet() const {
+        return callback.read([](const CallbackFunction* cb) { return cb != nullptr; });
     }
 
 private:
+    void copyFrom(const CallBack& other) {
+        CallbackFunction* copy = other.callback.read([](const CallbackFunction* cb) {
+            return cb ? new CallbackFunction(*cb) : nullptr;
+        });
+        callback.store(copy);
+    }
+
     // Member to store the callback function
-    CallbackFunction callback;
+    PublishedValue<CallbackFunction> callback;
+};
+
+// Multicast callback: any number of listeners, each stored inline (no allocation per call).
+// The subscriber list is copy-on-write: subscribe/unsubscribe build a new list and publish it,
+// invoke iterates the list it loaded without a lock (see PublishedValue); writers are serialized.
+template <typename... Args>
+class MultiCallBack {
+public:
+    using Subscriber = InlineFunction<void(Args...)>;
+    using SubscriberId = std::uint64_t;
+
+    MultiCallBack() = default;
+
+    MultiCallBack(const MultiCallBack& other)
+        : nextId(other.nextId.load())
+    {
+        copyFrom(other);
+    }
+
+    MultiCallBack& operator=(const MultiCallBack& other) {
+        if (this != &other) {
+            copyFrom(other);
+            nextId.store(other.nextId.load());
+        }
+        return *this;
+    }
+
+    // returns an id for unsubscribe, 0 if the callable is empty
+    template <typename F>
+    SubscriberId subscribe(F&& f) {
+        Subscriber fn(std::forward<F>(f));
+        if (!fn) return 0;
+        SubscriberId id = nextId.fetch_add(1);
+        subscribers.update([&](List& list) { list.push_back(Entry{ id, fn }); return true; });
+        return id;
+    }
+
+    bool unsubscribe(SubscriberId id) {
+        return subscribers.update([&](List& list) {
+            for (auto it = list.begin(); it != list.end(); ++it) {
+                if (it->id == id) {
+                    list.erase(it);
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    void clear() {
+        subscribers.store(nullptr);
+    }
+
+    // every listener gets the arguments as lvalues, in subscription order
+    template <typename... CallArgs>
+    void invoke(CallArgs&&... args) const {
+        subscribers.read([&](const List* list) {
+            if (!list) return;
+            for (const auto& entry : *list) {
+                entry.fn(args...);
+            }
+        });
+    }
+
+    std::size_t count() const {
+        return subscribers.read([](const List* list) { return list ? list->size() : std::size_t(0); });
+    }
+
+private:
+    struct Entry {
+        SubscriberId id;
+        Subscriber fn;
+    };
+    using List = std::vector<Entry>;
+
+    void copyFrom(const MultiCallBack& other) {
+        List* copy = other.subscribers.read([](const List* list) { return list ? new List(*list) : nullptr; });
+        subscribers.store(copy);
+    }
+
+    PublishedValue<List> subscribers;
+    std::atomic<SubscriberId> nextId{ 1 };
 };
 } // namespace NESES
 
@@ -68,6 +68,28 @@ namespace NESES
             return back;
         }
 
+        std::vector<std::string> Children(const std::string& path)
+        {
+            std::vector<std::string> back;
+            try
+            {
+                auto child = tree.get_child_optional(path);
+                if (child)
+                {
+                    for (const auto& kv : *child)
+                    {
+                        if (kv.first == "<xmlattr>" || kv.first == "<xmlcomment>")
+                            continue;
+                        back.push_back(kv.first);
+                    }
+                }
+            }
+            catch (const std::exception&)
+            {
+            }
+            return back;
+        }
+
         void Put(const std::string& path, const std::string& val)
         {
             try
@@ -113,4 +135,10 @@ namespace NESES
         ensureImpl();
         pimpl_->Put(path, val);
     }
+
+    NESESAPI std::vector<std::string> ConfigManager::GetChildNames(const std::string& path)
+    {
+        ensureImpl();
+        return pimpl_->Children(path);
+    }
 }
\ No newline at end of file
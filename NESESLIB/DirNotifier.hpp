@@ -0,0 +1,277 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <sys/vfs.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+/*
+Directory change notification from the kernel, Linux inotify. The DirWatcher waits on it instead of
+rescanning every delay, changes arrive as they happen. Changes made by other clients of a network file
+system (NFS, SMB/CIFS, FUSE mounts, ...) are not reported, IsRemoteFileSystem tells the watcher to poll
+those. Other platforms have no backend yet, IsSupported is false there.
+
+	DirNotifier notifier;
+	if (notifier.Open(dir))
+		while (notifier.Wait(2000, events)) { ... events.clear(); }
+*/
+
+namespace NESES
+{
+	enum class DirEventType
+	{
+		created,		// created or moved in
+		modified,		// written, reported for every write call
+		closedWrite,	// closed by a writer
+		erased,			// deleted or moved out
+		overflow,		// kernel queue overflowed, events were lost, rescan
+		dirGone			// the watched directory itself was deleted, moved or unmounted
+	};
+
+	struct DirEvent
+	{
+		DirEventType type{ DirEventType::overflow };
+		std::filesystem::path path;		// empty for overflow
+		bool isDir{ false };
+	};
+
+	class DirNotifier
+	{
+	private:
+#ifdef __linux__
+		int fd_{ -1 };
+		int wakeFd_{ -1 };		// lives as long as the notifier, Wake may run on another thread
+		std::unordered_map<int, std::filesystem::path> dirs_;	// watch descriptor to directory
+		alignas(inotify_event) char buf_[64 * 1024];
+
+		static constexpr uint32_t watchMask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+			| IN_DELETE_SELF | IN_MOVE_SELF | IN_EXCL_UNLINK | IN_ONLYDIR;
+
+		void Parse(ssize_t len, std::vector<DirEvent>& events)
+		{
+			for (char* p = buf_; p < buf_ + len; )
+			{
+				const inotify_event* ev = reinterpret_cast<const inotify_event*>(p);
+				p += sizeof(inotify_event) + ev->len;
+
+				DirEvent de;
+				de.isDir = (ev->mask & IN_ISDIR) != 0;
+				if (ev->mask & IN_Q_OVERFLOW)
+				{
+					events.push_back(de);
+					continue;
+				}
+				auto it = dirs_.find(ev->wd);
+				if (it == dirs_.end()) continue;
+
+				if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_IGNORED))
+				{
+					de.type = DirEventType::dirGone;
+					de.path = it->second;
+					de.isDir = true;
+					events.push_back(std::move(de));
+					if (ev->mask & IN_IGNORED)
+						dirs_.erase(it);
+					continue;
+				}
+				if (ev->len == 0) continue;
+
+				if (ev->mask & (IN_CREATE | IN_MOVED_TO)) de.type = DirEventType::created;
+				else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) de.type = DirEventType::erased;
+				else if (ev->mask & IN_CLOSE_WRITE) de.type = DirEventType::closedWrite;
+				else if (ev->mask & IN_MODIFY) de.type = DirEventType::modified;
+				else continue;
+				de.path = it->second / ev->name;
+				events.push_back(std::move(de));
+			}
+		}
+#endif
+
+	public:
+		DirNotifier()
+		{
+#ifdef __linux__
+			wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+		}
+
+		~DirNotifier()
+		{
+			Close();
+#ifdef __linux__
+			if (wakeFd_ >= 0) ::close(wakeFd_);
+#endif
+		}
+
+		DirNotifier(const DirNotifier&) = delete;
+		DirNotifier& operator=(const DirNotifier&) = delete;
+
+		static bool IsSupported()
+		{
+#ifdef __linux__
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		// network and FUSE file systems, inotify sees only the changes made through this machine there
+		static bool IsRemoteFileSystem(const std::filesystem::path& dir)
+		{
+#ifdef __linux__
+			struct statfs sfs;
+			if (::statfs(dir.c_str(), &sfs) != 0) return false;
+			switch (static_cast<uint32_t>(sfs.f_type))
+			{
+			case 0x6969:		// NFS
+			case 0x517B:		// SMB
+			case 0xFE534D42:	// SMB2
+			case 0xFF534D42:	// CIFS
+			case 0x65735546:	// FUSE (sshfs, ...)
+			case 0x01021997:	// 9P
+			case 0x00C36400:	// CEPH
+			case 0x5346414F:	// AFS
+				return true;
+			default:
+				return false;
+			}
+#else
+			(void)dir;
+			return true;
+#endif
+		}
+
+		bool IsOpen() const
+		{
+#ifdef __linux__
+			return fd_ >= 0;
+#else
+			return false;
+#endif
+		}
+
+		// descriptor to poll together with others (DirWatchService), -1 while closed
+		int Handle() const
+		{
+#ifdef __linux__
+			return fd_;
+#else
+			return -1;
+#endif
+		}
+
+		// watches dir, false if inotify is not available or the watch limit is reached
+		bool Open(const std::filesystem::path& dir)
+		{
+#ifdef __linux__
+			Close();
+			fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (fd_ < 0 || wakeFd_ < 0 || !Add(dir))
+			{
+				Close();
+				return false;
+			}
+			return true;
+#else
+			(void)dir;
+			return false;
+#endif
+		}
+
+		// one more directory on the same descriptor, not recursive
+		bool Add(const std::filesystem::path& dir)
+		{
+#ifdef __linux__
+			if (fd_ < 0) return false;
+			int wd = ::inotify_add_watch(fd_, dir.c_str(), watchMask);
+			if (wd < 0) return false;
+			dirs_[wd] = dir;
+			return true;
+#else
+			(void)dir;
+			return false;
+#endif
+		}
+
+		// drops the watches of dir and of every folder below it, dir moved out or deleted
+		void Remove(const std::filesystem::path& dir)
+		{
+#ifdef __linux__
+			for (auto it = dirs_.begin(); it != dirs_.end(); )
+			{
+				auto res = std::mismatch(dir.begin(), dir.end(), it->second.begin(), it->second.end());
+				if (res.first == dir.end())
+				{
+					if (fd_ >= 0) ::inotify_rm_watch(fd_, it->first);
+					it = dirs_.erase(it);
+				}
+				else
+					++it;
+			}
+#else
+			(void)dir;
+#endif
+		}
+
+		void Close()
+		{
+#ifdef __linux__
+			if (fd_ >= 0) ::close(fd_);
+			fd_ = -1;
+			dirs_.clear();
+#endif
+		}
+
+		// waits up to timeoutMs for changes and appends them, false on error; Wake returns early with none
+		bool Wait(int timeoutMs, std::vector<DirEvent>& events)
+		{
+#ifdef __linux__
+			if (fd_ < 0) return false;
+			pollfd fds[2] = { { fd_, POLLIN, 0 }, { wakeFd_, POLLIN, 0 } };
+			int n = ::poll(fds, 2, timeoutMs);
+			if (n < 0) return errno == EINTR;
+			if (fds[1].revents & POLLIN)
+			{
+				uint64_t value;
+				while (::read(wakeFd_, &value, sizeof(value)) > 0) {}
+			}
+			if (!(fds[0].revents & POLLIN)) return true;
+
+			while (true)
+			{
+				ssize_t len = ::read(fd_, buf_, sizeof(buf_));
+				if (len > 0)
+				{
+					Parse(len, events);
+					continue;
+				}
+				return len < 0 && (errno == EAGAIN || errno == EINTR);
+			}
+#else
+			(void)timeoutMs;
+			(void)events;
+			return false;
+#endif
+		}
+
+		// any thread, ends a Wait in progress
+		void Wake()
+		{
+#ifdef __linux__
+			if (wakeFd_ < 0) return;
+			uint64_t one = 1;
+			ssize_t res = ::write(wakeFd_, &one, sizeof(one));
+			(void)res;
+#endif
+		}
+	};
+}
@@ -0,0 +1,440 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <filesystem>
+#include <thread>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <cerrno>
+#endif
+#include "App.hpp"
+#include "FileInfo.hpp"
+
+// getdents64 + one statx per accepted file instead of directory_iterator and a stat per query (glibc 2.28+)
+#if defined(__linux__) && defined(STATX_TYPE) && defined(SYS_getdents64)
+#define NESES_DIRSCAN_GETDENTS 1
+#endif
+
+/*
+Directory tree scan for the DirWatcher. Every directory is one unit of work in a shared queue; helper
+tasks on the io lane and the calling thread take directories from it until the tree is done, so a tree
+with many folders is read on all cores while a single folder costs nothing extra. The caller never
+depends on a helper starting, a busy or stopped pool only makes the scan serial.
+
+On Linux a folder is read with getdents64 in 32KB blocks, the entry type comes from the folder itself
+and a file that passes the rules costs one statx (size, time, inode), which matters on NFS / SMB.
+
+Rules are globs, case insensitive: '*' and '?' stay within a name, '**' crosses folders. A pattern
+with '/' (e.g. "20??/raw") is matched against the path relative to the root, one without against the name only.
+
+	DirScanOptions opt;
+	opt.recursive = true;
+	opt.maxDepth = 3;						// root files are depth 0
+	opt.exclude = { ".*", "tmp", "20??/raw" };
+	opt.include = { "*.mp4", "*.mxf" };		// files only, empty takes every file
+*/
+
+namespace NESES
+{
+	struct DirScanOptions
+	{
+		bool recursive{ false };
+		int maxDepth{ -1 };						// folder levels below the root, -1 no limit
+		std::vector<std::string> include;		// file globs
+		std::vector<std::string> exclude;		// file and folder globs, an excluded folder is not entered
+		size_t threads{ 0 };					// threads reading folders, the caller included, 0 one per core
+	};
+
+	struct DirScanResult
+	{
+		std::vector<FileInfo> files;
+		std::vector<std::filesystem::path> dirs;	// folders read
+		bool complete{ true };						// false if a folder could not be read or the scan was cancelled
+	};
+
+	class DirScanner
+	{
+	public:
+		using Accept = std::function<bool(const std::filesystem::path&)>;
+		using Cancel = std::function<bool()>;
+
+	private:
+		struct Job
+		{
+			std::mutex lock;
+			std::condition_variable cv;
+			std::deque<std::pair<std::filesystem::path, int>> dirs;		// folder, depth
+			size_t busy{ 0 };			// folders being read
+			size_t active{ 0 };			// threads in Work
+			DirScanResult result;
+		};
+
+		DirScanOptions options_;
+		bool relativeRules_{ false };	// a rule with '/', entries need their relative path
+
+		static char Lower(char c)
+		{
+			return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+
+		static bool AnyMatch(const std::vector<std::string>& globs, std::string_view name, std::string_view rel)
+		{
+			for (const auto& glob : globs)
+			{
+				if (GlobMatch(glob, glob.find('/') == std::string::npos ? name : rel))
+					return true;
+			}
+			return false;
+		}
+
+		std::string Relative(const std::filesystem::path& root, const std::filesystem::path& p) const
+		{
+			return relativeRules_ ? p.lexically_relative(root).generic_string() : std::string();
+		}
+
+		bool WantDir(const std::filesystem::path& root, const std::filesystem::path& dir, int depth) const
+		{
+			if (!options_.recursive || (options_.maxDepth >= 0 && depth > options_.maxDepth))
+				return false;
+			return !AnyMatch(options_.exclude, dir.filename().string(), Relative(root, dir));
+		}
+
+#ifdef NESES_DIRSCAN_GETDENTS
+		struct Dirent64
+		{
+			uint64_t d_ino;
+			int64_t d_off;
+			unsigned short d_reclen;
+			unsigned char d_type;
+			char d_name[1];
+		};
+
+		static constexpr unsigned statxMask = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_INO;
+
+		// file clock of the library against the statx epoch, measured once on "/"
+		static std::chrono::nanoseconds FileClockOffset()
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				struct stat before, after;
+				std::error_code ec;
+				if (::stat("/", &before) != 0) break;
+				auto ft = std::filesystem::last_write_time("/", ec);
+				if (ec || ::stat("/", &after) != 0) break;
+				if (before.st_mtim.tv_sec != after.st_mtim.tv_sec || before.st_mtim.tv_nsec != after.st_mtim.tv_nsec)
+					continue;
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(ft.time_since_epoch())
+					- (std::chrono::seconds(before.st_mtim.tv_sec) + std::chrono::nanoseconds(before.st_mtim.tv_nsec));
+			}
+			return std::chrono::nanoseconds(0);
+		}
+
+		static std::filesystem::file_time_type FileTime(const statx_timestamp& ts)
+		{
+			static const std::chrono::nanoseconds offset = FileClockOffset();
+			auto since = std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec) + offset;
+			return std::filesystem::file_time_type(std::chrono::duration_cast<std::filesystem::file_time_type::duration>(since));
+		}
+
+		static void Fill(const struct statx& stx, FileInfo& fi)
+		{
+			fi.size = stx.stx_size;
+			fi.inode = stx.stx_ino;
+			fi.setFileTime(FileTime(stx.stx_mtime));
+		}
+
+		bool ReadDir(const std::filesystem::path& root, const std::filesystem::path& dir, int depth, const Accept& accept,
+			std::vector<FileInfo>& out, std::vector<std::pair<std::filesystem::path, int>>& subdirs) const
+		{
+			int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (fd < 0)
+				return errno == EACCES;		// skipped like directory_options::skip_permission_denied
+			alignas(Dirent64) char buf[32 * 1024];
+			FileInfo fi;
+			bool ok = true;
+			while (true)
+			{
+				long n = ::syscall(SYS_getdents64, fd, buf, sizeof(buf));
+				if (n <= 0)
+				{
+					ok = n == 0;
+					break;
+				}
+				for (long off = 0; off < n; )
+				{
+					const Dirent64* d = reinterpret_cast<const Dirent64*>(buf + off);
+					off += d->d_reclen;
+					const char* name = d->d_name;
+					if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+						continue;
+
+					struct statx stx;
+					bool haveStat = false;
+					unsigned char type = d->d_type;
+					if (type == DT_UNKNOWN || type == DT_LNK)
+					{
+						// file system without d_type, or a link (followed for files, like is_regular_file)
+						if (::statx(fd, name, type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW, statxMask, &stx) != 0)
+							continue;
+						haveStat = true;
+						if (S_ISREG(stx.stx_mode)) type = DT_REG;
+						else if (S_ISDIR(stx.stx_mode) && type == DT_UNKNOWN) type = DT_DIR;
+						else continue;
+					}
+
+					if (type == DT_DIR)
+					{
+						std::filesystem::path sub = dir / name;
+						if (WantDir(root, sub, depth + 1))
+							subdirs.emplace_back(std::move(sub), depth + 1);
+						continue;
+					}
+					if (type != DT_REG)
+						continue;
+
+					std::filesystem::path fpath = dir / name;
+					if (!Accepts(root, fpath) || (accept && !accept(fpath)))
+						continue;
+					if (!haveStat && ::statx(fd, name, AT_SYMLINK_NOFOLLOW, statxMask, &stx) != 0)
+						continue;		// gone meanwhile
+					fi.clear();
+					Fill(stx, fi);
+					fi.hash = std::filesystem::hash_value(fpath);
+					fi.fpath = std::move(fpath);
+					out.push_back(fi);
+				}
+			}
+			::close(fd);
+			return ok;
+		}
+#else
+		// one folder, its files to out, its subfolders to subdirs; false if it could not be read
+		bool ReadDir(const std::filesystem::path& root, const std::filesystem::path& dir, int depth, const Accept& accept,
+			std::vector<FileInfo>& out, std::vector<std::pair<std::filesystem::path, int>>& subdirs) const
+		{
+			std::error_code ec;
+			std::filesystem::directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied, ec);
+			if (ec) return false;
+			FileInfo fi;
+			for (; it != std::filesystem::directory_iterator(); it.increment(ec))
+			{
+				if (ec) return false;
+				const auto& entry = *it;
+				std::error_code eec;
+				if (entry.is_directory(eec))
+				{
+					if (!entry.is_symlink(eec) && WantDir(root, entry.path(), depth + 1))
+						subdirs.emplace_back(entry.path(), depth + 1);
+					continue;
+				}
+				if (!entry.is_regular_file(eec) || !Accepts(root, entry.path()) || (accept && !accept(entry.path())))
+					continue;
+				auto ftime = entry.last_write_time(eec);
+				uintmax_t fsize = eec ? 0 : entry.file_size(eec);
+				if (eec) continue;		// gone meanwhile
+				fi.clear();
+				fi.fpath = entry.path();
+				fi.size = fsize;
+				fi.setFileTime(ftime);
+				fi.hash = std::filesystem::hash_value(entry.path());
+				out.push_back(fi);
+			}
+			return !ec;
+		}
+#endif
+
+		void Work(const std::shared_ptr<Job>& job, const std::filesystem::path& root, const Accept& accept, const Cancel& cancel) const
+		{
+			std::vector<FileInfo> local;
+			std::vector<std::pair<std::filesystem::path, int>> subdirs;
+			std::unique_lock<std::mutex> lock(job->lock);
+			job->active++;
+			while (true)
+			{
+				if (job->dirs.empty())
+				{
+					if (job->busy == 0) break;
+					job->cv.wait(lock);
+					continue;
+				}
+				if (cancel && cancel())
+				{
+					job->result.complete = false;
+					job->dirs.clear();
+					continue;
+				}
+				auto [dir, depth] = std::move(job->dirs.front());
+				job->dirs.pop_front();
+				job->busy++;
+				lock.unlock();
+
+				subdirs.clear();
+				bool ok = ReadDir(root, dir, depth, accept, local, subdirs);
+
+				lock.lock();
+				job->busy--;
+				job->result.complete = job->result.complete && ok;
+				job->result.dirs.push_back(std::move(dir));
+				for (auto& sub : subdirs)
+					job->dirs.push_back(std::move(sub));
+				if (!subdirs.empty() || (job->busy == 0 && job->dirs.empty()))
+					job->cv.notify_all();
+			}
+			job->result.files.insert(job->result.files.end(), local.begin(), local.end());
+			job->active--;
+			job->cv.notify_all();
+		}
+
+	public:
+		DirScanner() = default;
+		explicit DirScanner(const DirScanOptions& options) { SetOptions(options); }
+
+		void SetOptions(const DirScanOptions& options)
+		{
+			options_ = options;
+			relativeRules_ = false;
+			for (const auto* rules : { &options_.include, &options_.exclude })
+			{
+				for (const auto& glob : *rules)
+					relativeRules_ = relativeRules_ || glob.find('/') != std::string::npos;
+			}
+		}
+
+		const DirScanOptions& GetOptions() const { return options_; }
+
+		// '*' '?' within a name, '**' across folders, ASCII case insensitive
+		static bool GlobMatch(std::string_view pattern, std::string_view text)
+		{
+			while (!pattern.empty())
+			{
+				if (pattern[0] == '*')
+				{
+					bool deep = pattern.size() > 1 && pattern[1] == '*';
+					std::string_view rest = pattern.substr(deep ? 2 : 1);
+					if (deep && !rest.empty() && rest[0] == '/' && GlobMatch(rest.substr(1), text))
+						return true;		// "**/" matches no folder as well
+					for (size_t i = 0; ; i++)
+					{
+						if (GlobMatch(rest, text.substr(i)))
+							return true;
+						if (i >= text.size() || (!deep && text[i] == '/'))
+							return false;
+					}
+				}
+				if (text.empty())
+					return false;
+				if (pattern[0] == '?' ? text[0] == '/' : Lower(pattern[0]) != Lower(text[0]))
+					return false;
+				pattern.remove_prefix(1);
+				text.remove_prefix(1);
+			}
+			return text.empty();
+		}
+
+		// file rules only, the folders above it are not checked
+		bool Accepts(const std::filesystem::path& root, const std::filesystem::path& file) const
+		{
+			if (options_.include.empty() && options_.exclude.empty())
+				return true;
+			std::string name = file.filename().string();
+			std::string rel = Relative(root, file);
+			if (AnyMatch(options_.exclude, name, rel))
+				return false;
+			return options_.include.empty() || AnyMatch(options_.include, name, rel);
+		}
+
+		// size, time and inode of a regular file (links followed), false if it is not one or is gone
+		static bool StatFile(const std::filesystem::path& fpath, FileInfo& fi)
+		{
+#ifdef NESES_DIRSCAN_GETDENTS
+			struct statx stx;
+			if (::statx(AT_FDCWD, fpath.c_str(), 0, statxMask, &stx) != 0 || !S_ISREG(stx.stx_mode))
+				return false;
+			Fill(stx, fi);
+			return true;
+#else
+			std::error_code ec;
+			if (!std::filesystem::is_regular_file(fpath, ec))
+				return false;
+			auto ftime = std::filesystem::last_write_time(fpath, ec);
+			uintmax_t fsize = ec ? 0 : std::filesystem::file_size(fpath, ec);
+			if (ec)
+				return false;
+			fi.size = fsize;
+			fi.setFileTime(ftime);
+			return true;
+#endif
+		}
+
+		// folder levels of p below root, 0 root itself, -1 not below root
+		static int DepthOf(const std::filesystem::path& root, const std::filesystem::path& p)
+		{
+			int depth = 0;
+			for (const auto& part : p.lexically_relative(root))
+			{
+				if (part == ".." || part.empty()) return -1;
+				if (part != ".") depth++;
+			}
+			return p.lexically_relative(root).empty() ? -1 : depth;
+		}
+
+		// folder rules for a folder found after the scan (notify mode)
+		bool AcceptsDir(const std::filesystem::path& root, const std::filesystem::path& dir) const
+		{
+			int depth = DepthOf(root, dir);
+			return depth > 0 && WantDir(root, dir, depth);
+		}
+
+		/*
+		Files below dir passing the rules and accept, in no particular order. dir is root or a folder below it
+		(depth its level), the rules stay relative to root. Not complete if a folder could not be read or
+		cancel returned true, the files are partial then.
+		*/
+		DirScanResult Scan(const std::filesystem::path& root, const std::filesystem::path& dir, int depth,
+			const Accept& accept = nullptr, const Cancel& cancel = nullptr) const
+		{
+			auto job = std::make_shared<Job>();
+			job->dirs.emplace_back(dir, depth);
+
+			size_t threads = options_.threads != 0 ? options_.threads : std::thread::hardware_concurrency();
+			if (options_.recursive && threads > 1)
+			{
+				auto& executor = App::Instance().GetExecutor(Lane::io);
+				auto self = std::make_shared<const DirScanner>(*this);		// helpers may start after the scan is over
+				for (size_t i = 1; i < threads; i++)
+				{
+					auto task = executor.GetNew("dirscan", [job, self, root, accept, cancel]()
+						{
+							self->Work(job, root, accept, cancel);
+							return BackObject();
+						});
+					if (!task || !executor.Enqueue(task))
+						break;
+				}
+			}
+
+			Work(job, root, accept, cancel);
+			std::unique_lock<std::mutex> lock(job->lock);
+			job->cv.wait(lock, [&job]() { return job->active == 0; });
+			return std::move(job->result);
+		}
+
+		DirScanResult Scan(const std::filesystem::path& root, const Accept& accept = nullptr, const Cancel& cancel = nullptr) const
+		{
+			return Scan(root, root, 0, accept, cancel);
+		}
+	};
+}
@@ -0,0 +1,100 @@
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "DirSnapshot.hpp"
+
+// windows.h and the posix headers stay inside the library, clients of DirWatcher.hpp do not get them
+
+// data on the disk before it is renamed into place, empty string or the error
+static std::string WriteDurable(const std::filesystem::path& tmp, const std::string& data)
+{
+#ifdef _WIN32
+	HANDLE h = CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (h == INVALID_HANDLE_VALUE)
+		return "Cannot create " + tmp.string();
+	size_t done = 0;
+	bool ok = true;
+	while (ok && done < data.size())
+	{
+		DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size() - done, 1u << 30));
+		DWORD written = 0;
+		ok = WriteFile(h, data.data() + done, chunk, &written, nullptr) && written > 0;
+		done += written;
+	}
+	ok = ok && FlushFileBuffers(h);
+	CloseHandle(h);
+	return ok ? std::string() : "Cannot write " + tmp.string();
+#else
+	int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return "Cannot create " + tmp.string() + " : " + std::strerror(errno);
+	size_t done = 0;
+	while (done < data.size())
+	{
+		ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		done += static_cast<size_t>(n);
+	}
+	bool ok = done == data.size() && ::fsync(fd) == 0;
+	std::string err = ok ? std::string() : "Cannot write " + tmp.string() + " : " + std::strerror(errno);
+	::close(fd);
+	return err;
+#endif
+}
+
+#ifndef _WIN32
+// the rename itself survives a crash once its folder is synced
+static void SyncFolder(const std::filesystem::path& file)
+{
+	std::filesystem::path dir = file.parent_path();
+	int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	::fsync(fd);
+	::close(fd);
+}
+#endif
+
+NESESAPI std::string NESES::ReplaceFileDurable(const std::filesystem::path& file, const std::string& data)
+{
+	std::filesystem::path tmp = file;
+	tmp += ".tmp";
+	std::error_code ec;
+	std::string err = WriteDurable(tmp, data);
+	if (!err.empty())
+	{
+		std::filesystem::remove(tmp, ec);
+		return err;
+	}
+#ifdef _WIN32
+	if (!MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		std::filesystem::remove(tmp, ec);
+		return "Cannot rename " + tmp.string();
+	}
+#else
+	std::filesystem::rename(tmp, file, ec);
+	if (ec)
+	{
+		std::string msg = "Cannot rename " + tmp.string() + " : " + ec.message();
+		std::filesystem::remove(tmp, ec);
+		return msg;
+	}
+	SyncFolder(file);
+#endif
+	return std::string();
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+#include "Exporter.h"
+#include "FileInfo.hpp"
+#include "BackObject.hpp"
+
+/*
+Known files of a DirWatcher on disk, so a restart tells what changed while it was down instead of taking
+the folder as it finds it. Sorted by path, every path shares its common prefix with the one before:
+
+	file   : "NESDSNP1" [root length][root][count] then count entries
+	entry  : [shared prefix length][suffix length][suffix][size][zigzag mtime ticks][inode]
+
+Numbers are LEB128 varints, paths are relative to the root in UTF-8 with native separators. The hash is
+not stored, the library does not promise the same one across builds; it is taken again on load. Save
+writes <file>.tmp, flushes it to the disk and renames it over file (the folder is synced as well on POSIX),
+after a crash or power loss there is the old snapshot or the new one. The file calls are in DirSnapshot.cpp.
+*/
+
+namespace NESES
+{
+	// data on the disk in <file>.tmp, renamed over file and the rename synced; empty string or the error
+	NESESAPI std::string ReplaceFileDurable(const std::filesystem::path& file, const std::string& data);
+
+	constexpr char DirSnapshotMagic[8] = { 'N', 'E', 'S', 'D', 'S', 'N', 'P', '1' };
+
+	class DirSnapshot
+	{
+	private:
+		static void PutVarint(std::string& out, uint64_t v)
+		{
+			while (v >= 0x80)
+			{
+				out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+				v >>= 7;
+			}
+			out.push_back(static_cast<char>(v));
+		}
+
+		static void PutString(std::string& out, const std::string& s)
+		{
+			PutVarint(out, s.size());
+			out.append(s);
+		}
+
+		static bool GetVarint(const std::string& in, size_t& pos, uint64_t& v)
+		{
+			v = 0;
+			for (int shift = 0; shift < 64 && pos < in.size(); shift += 7)
+			{
+				uint8_t b = static_cast<uint8_t>(in[pos++]);
+				v |= static_cast<uint64_t>(b & 0x7F) << shift;
+				if (!(b & 0x80)) return true;
+			}
+			return false;
+		}
+
+		static bool GetString(const std::string& in, size_t& pos, std::string& out)
+		{
+			uint64_t len;
+			if (!GetVarint(in, pos, len) || len > in.size() - pos) return false;
+			out.assign(in, pos, static_cast<size_t>(len));
+			pos += static_cast<size_t>(len);
+			return true;
+		}
+
+		static BackObject Fail(const std::string& desc)
+		{
+			BackObject back;
+			back.Success = false;
+			back.ErrDesc = desc;
+			return back;
+		}
+
+	public:
+		// files below root only, file is replaced as a whole
+		static BackObject Save(const std::filesystem::path& file, const std::filesystem::path& root, std::vector<FileInfo>& files)
+		{
+			std::vector<std::pair<std::string, FileInfo*>> items;
+			items.reserve(files.size());
+			for (auto& fi : files)
+			{
+				std::filesystem::path rel = fi.fpath.lexically_relative(root);
+				if (rel.empty() || *rel.begin() == "..")
+					continue;
+				items.emplace_back(rel.u8string(), &fi);
+			}
+			std::sort(items.begin(), items.end(),
+				[](const auto& a, const auto& b) { return a.first < b.first; });
+
+			std::string out(DirSnapshotMagic, sizeof(DirSnapshotMagic));
+			PutString(out, root.u8string());
+			PutVarint(out, items.size());
+			const std::string* prev = nullptr;
+			for (auto& item : items)
+			{
+				size_t shared = 0;
+				if (prev)
+				{
+					size_t most = std::min(prev->size(), item.first.size());
+					while (shared < most && (*prev)[shared] == item.first[shared])
+						shared++;
+				}
+				PutVarint(out, shared);
+				PutString(out, item.first.substr(shared));
+				FileInfo& fi = *item.second;
+				int64_t ticks = static_cast<int64_t>(fi.GetFileTime().time_since_epoch().count());
+				PutVarint(out, fi.size);
+				PutVarint(out, (static_cast<uint64_t>(ticks) << 1) ^ static_cast<uint64_t>(ticks >> 63));
+				PutVarint(out, fi.inode);
+				prev = &item.first;
+			}
+
+			std::string err = ReplaceFileDurable(file, out);
+			if (!err.empty())
+				return Fail(err);
+			BackObject back;
+			back.Success = true;
+			return back;
+		}
+
+		// false for a missing, damaged or other root's snapshot, files is left empty then
+		static BackObject Load(const std::filesystem::path& file, const std::filesystem::path& root, std::vector<FileInfo>& files)
+		{
+			files.clear();
+			std::ifstream f(file, std::ios::binary);
+			if (!f)
+				return Fail("No snapshot " + file.string());
+			std::string in((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+			size_t pos = sizeof(DirSnapshotMagic);
+			std::string savedRoot;
+			uint64_t count;
+			if (in.size() < pos || std::memcmp(in.data(), DirSnapshotMagic, pos) != 0
+				|| !GetString(in, pos, savedRoot) || !GetVarint(in, pos, count))
+				return Fail("Not a snapshot " + file.string());
+			if (savedRoot != root.u8string())
+				return Fail("Snapshot " + file.string() + " is of " + savedRoot);
+			if (count > in.size())
+				return Fail("Damaged snapshot " + file.string());
+
+			files.reserve(static_cast<size_t>(count));
+			std::string rel, suffix;
+			FileInfo fi;
+			for (uint64_t i = 0; i < count; i++)
+			{
+				uint64_t shared, size, zticks, inode;
+				if (!GetVarint(in, pos, shared) || shared > rel.size() || !GetString(in, pos, suffix)
+					|| !GetVarint(in, pos, size) || !GetVarint(in, pos, zticks) || !GetVarint(in, pos, inode))
+				{
+					files.clear();
+					return Fail("Damaged snapshot " + file.string());
+				}
+				rel.resize(static_cast<size_t>(shared));
+				rel += suffix;
+				int64_t ticks = static_cast<int64_t>(zticks >> 1) ^ -static_cast<int64_t>(zticks & 1);
+
+				fi.clear();
+				fi.fpath = root / std::filesystem::u8path(rel);
+				fi.hash = std::filesystem::hash_value(fi.fpath);
+				fi.size = size;
+				fi.inode = inode;
+				fi.setFileTime(std::filesystem::file_time_type(std::filesystem::file_time_type::duration(ticks)));
+				files.push_back(fi);
+			}
+			BackObject back;
+			back.Success = true;
+			return back;
+		}
+	};
+}
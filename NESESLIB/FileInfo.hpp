@@ -1,6 +1,8 @@
 #pragma once
 #include <filesystem>
+#include <cstdint>
 #include "NesesTime.hpp"
+#include "TimeService.hpp"
 
 
 /*
@@ -17,7 +19,8 @@ namespace NESES
 		none,
 		created,
 		modified,
-		erased
+		erased,
+		ready		// stable file mode, size and time settled or closed by the writer
 	};
 
 	class FileInfo
@@ -29,6 +32,8 @@ namespace NESES
 	public:
 		std::filesystem::path fpath;
 		size_t hash{ 0 };
+		uintmax_t size{ 0 };
+		uint64_t inode{ 0 };		// 0 where the scan does not read it
 		NesesDateTime ntime;
 		FileStatus fs{ FileStatus::none };
 		bool IsDeleted{ false };
@@ -104,6 +109,8 @@ namespace NESES
 		{
 			fpath.clear();
 			hash = 0;
+			size = 0;
+			inode = 0;
 			ftime = std::filesystem::file_time_type::clock::now(); // todo min yap bunu
 			fs = FileStatus::none;
 			IsDeleted = false;
@@ -122,11 +129,22 @@ namespace NESES
 
 		void filetimeToTimet()
 		{
-			std::time_t systimet(0);
-			struct tm* systm;
-			systimet = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now() - (std::filesystem::file_time_type::clock::now() - ftime));
-			systm = std::localtime(&systimet);
-			ntime.fromTm(*systm);
+			using fclock = std::filesystem::file_time_type::clock;
+
+			// the file clock / system clock distance is constant, read both clocks once a second instead of per file
+			thread_local int64_t offsetSec = INT64_MIN;
+			thread_local fclock::duration offset{};
+			int64_t nowSec = TimeService::CoarseNowNs() / 1000000000;
+			if (nowSec != offsetSec)
+			{
+				offset = std::chrono::duration_cast<fclock::duration>(std::chrono::system_clock::now().time_since_epoch()) - fclock::now().time_since_epoch();
+				offsetSec = nowSec;
+			}
+
+			std::time_t systimet = static_cast<std::time_t>(std::chrono::duration_cast<std::chrono::seconds>(ftime.time_since_epoch() + offset).count());
+			struct tm systm;
+			TimeService::LocalTime(systimet, systm);
+			ntime.fromTm(systm);
 
 		}
 	};
@@ -0,0 +1,424 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <charconv>
+#include <memory>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "TimeService.hpp"
+#include "LogRotation.hpp"
+#include "LogBinary.hpp"
+#include "LogSink.hpp"
+
+namespace NESES
+{
+	// when the buffered file output reaches the disk
+	struct LogFlushPolicy
+	{
+		size_t bytes{ 64 * 1024 };		// write once this much is buffered
+		int intervalMs{ 1000 };			// write buffered lines at least this often, 0 writes every batch
+		bool flushOnError{ true };		// error lines are written right away
+	};
+
+	// <path><file format><ext> of the log files (ext .txt, .nlog), rebuilt only when the cached boundary passes
+	class LogFileName
+	{
+	private:
+		std::string path_;					// directory prefix, as given to Logger::Init
+		std::string fileFormat_;
+		std::string ext_{ ".txt" };
+		std::string current_;
+		CachedTimeFormat nameFormat_;
+		int64_t nextBoundary_{ INT64_MIN };	// wall clock ns the file name has to be checked again
+
+		// smallest unit the file name format changes with, in seconds
+		int64_t FormatGranularity() const
+		{
+			int64_t back = 86400;
+			for (size_t i = 0; i + 1 < fileFormat_.size(); i++)
+			{
+				if (fileFormat_[i] != '%') continue;
+				char c = fileFormat_[++i];
+				if (c == 'E' || c == 'O')		// modifiers, %Ey %OH ...
+				{
+					if (i + 1 >= fileFormat_.size()) break;
+					c = fileFormat_[++i];
+				}
+				switch (c)
+				{
+				case 'S': case 'T': case 'r': case 'c': case 's': case 'X': return 1;
+				case 'M': case 'R': back = back < 60 ? back : 60; break;
+				case 'H': case 'I': case 'k': case 'l': case 'p': back = back < 3600 ? back : 3600; break;
+				default: break;
+				}
+			}
+			return back;
+		}
+
+		// next wall clock instant, in local time, the file name may change
+		int64_t NextBoundary(int64_t nowNs) const
+		{
+			int64_t granularity = FormatGranularity();
+			std::time_t t = static_cast<std::time_t>(nowNs / 1000000000);
+			std::tm tmv;
+			TimeService::LocalTime(t, tmv);
+			if (granularity < 86400)
+			{
+				int64_t secOfDay = tmv.tm_hour * 3600 + tmv.tm_min * 60 + tmv.tm_sec;
+				return (static_cast<int64_t>(t) + granularity - secOfDay % granularity) * 1000000000;
+			}
+
+			// next local midnight, mktime takes care of 23 / 25 hour days
+			tmv.tm_mday += 1;
+			tmv.tm_hour = 0;
+			tmv.tm_min = 0;
+			tmv.tm_sec = 0;
+			tmv.tm_isdst = -1;
+			std::time_t midnight = std::mktime(&tmv);
+			if (midnight <= t) midnight = t + 3600;
+			return static_cast<int64_t>(midnight) * 1000000000;
+		}
+
+	public:
+		void Set(const std::string& path, const std::string& fileFormat, const std::string& ext = ".txt")
+		{
+			path_ = path;
+			fileFormat_ = fileFormat;
+			ext_ = ext;
+			nameFormat_.SetFormat(fileFormat_);
+			current_.clear();
+			nextBoundary_ = INT64_MIN;
+		}
+
+		// true if the name changed, the new one is in Current()
+		bool Update(int64_t wallNs)
+		{
+			if (wallNs < nextBoundary_) return false;
+			nextBoundary_ = NextBoundary(wallNs);
+			std::string_view name = nameFormat_.Format(wallNs);
+			if (current_.size() == path_.size() + name.size() + ext_.size()
+				&& current_.compare(path_.size(), name.size(), name.data(), name.size()) == 0)
+				return false;
+			current_.assign(path_).append(name.data(), name.size()).append(ext_);
+			return true;
+		}
+
+		const std::string& Current() const { return current_; }
+
+		// <path><name>.<index><ext>, index 0 is Current()
+		std::string Indexed(size_t index) const
+		{
+			if (index == 0 || current_.size() < ext_.size()) return current_;
+			return current_.substr(0, current_.size() - ext_.size()) + "." + std::to_string(index) + ext_;
+		}
+
+		// index a restart continues at: the newest file of Current(), the one after it if that is compressed
+		size_t WriteIndex() const
+		{
+			namespace fs = std::filesystem;
+			if (current_.size() < ext_.size()) return 0;
+			fs::path cur(current_);
+			std::string stem = cur.filename().string();
+			stem.resize(stem.size() - ext_.size());
+			fs::path dir = cur.parent_path();
+			if (dir.empty()) dir = ".";
+
+			size_t last = 0;
+			bool closed = false;
+			std::error_code ec;
+			for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+			{
+				std::string name = it->path().filename().string();
+				if (name.compare(0, stem.size(), stem) != 0) continue;
+				std::string_view rest(name);
+				rest.remove_prefix(stem.size());
+				bool gz = rest.size() >= 3 && rest.compare(rest.size() - 3, 3, ".gz") == 0;
+				if (gz) rest.remove_suffix(3);
+				if (rest.size() < ext_.size() || rest.compare(rest.size() - ext_.size(), ext_.size(), ext_) != 0) continue;
+				rest.remove_suffix(ext_.size());
+
+				size_t index = 0;
+				if (!rest.empty())
+				{
+					if (rest[0] != '.') continue;
+					auto res = std::from_chars(rest.data() + 1, rest.data() + rest.size(), index);
+					if (res.ec != std::errc() || res.ptr != rest.data() + rest.size()) continue;
+				}
+				if (index > last)
+				{
+					last = index;
+					closed = gz;
+				}
+				else if (index == last)
+				{
+					closed = closed || gz;
+				}
+			}
+			return closed ? last + 1 : last;
+		}
+	};
+
+	/*
+	Log file writer of the Logger, not thread safe (logger thread only).
+	Lines are appended to one buffer and written with a single write call per flush, the file is kept
+	open and the file name is rebuilt only when the name format can change (next day for "%Y-%m-%d").
+	With a rotation policy the file also rolls by size / age to <name>.1.txt, <name>.2.txt ..., closed
+	files go to the LogRotator. In binary mode records are LogBinary encoded instead of formatted.
+	*/
+	class LogFileSink : public LogSink
+	{
+	private:
+		static constexpr size_t defaultBufferSize = 256 * 1024;
+
+		LogFileName fileName_;
+		std::string currentFile_;
+		std::string buffer_;
+		LogFlushPolicy policy_;
+		LogRotationPolicy rotation_;
+		std::shared_ptr<LogRotator> rotator_;
+		size_t bufferSize_;
+		size_t index_{ 0 };					// roll index of currentFile_
+		uint64_t fileBytes_{ 0 };			// size of currentFile_, buffered lines included
+		int64_t fileStartNs_{ 0 };			// wall clock ns currentFile_ was started
+		int64_t firstBuffered_{ 0 };		// monotonic ns the oldest buffered line was added
+		uint64_t bufferedLines_{ 0 };
+		uint64_t writeErrors_{ 0 };
+		int fd_{ -1 };
+		bool binary_{ false };
+		LogBinaryEncoder encoder_;
+		std::string binBuf_;
+
+		bool Open()
+		{
+			if (fd_ >= 0) return true;
+			if (currentFile_.empty()) return false;
+#ifdef _WIN32
+			fd_ = _open(currentFile_.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY | _O_NOINHERIT, _S_IREAD | _S_IWRITE);
+#else
+			fd_ = ::open(currentFile_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+			if (fd_ < 0)
+			{
+				std::cerr << "Cannot open logfile " << currentFile_ << " : " << std::strerror(errno) << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		bool WriteAll(const char* data, size_t len)
+		{
+			while (len > 0)
+			{
+#ifdef _WIN32
+				int n = _write(fd_, data, static_cast<unsigned int>(len > 0x40000000 ? 0x40000000 : len));
+#else
+				ssize_t n = ::write(fd_, data, len);
+#endif
+				if (n < 0)
+				{
+					if (errno == EINTR) continue;
+					return false;
+				}
+				data += n;
+				len -= static_cast<size_t>(n);
+			}
+			return true;
+		}
+
+		// flushes and closes the current file, it will not be written again
+		void Finish()
+		{
+			Close();
+			if (rotator_ && !currentFile_.empty())
+				rotator_->Finished(currentFile_);
+		}
+
+		void SwitchTo(size_t index, int64_t wallNs)
+		{
+			index_ = index;
+			currentFile_ = fileName_.Indexed(index_);
+			std::error_code ec;
+			fileBytes_ = std::filesystem::file_size(currentFile_, ec);
+			if (ec) fileBytes_ = 0;
+			fileStartNs_ = wallNs;
+			if (rotator_)
+				rotator_->Opened(currentFile_);
+		}
+
+		void Buffer(std::string_view data, bool newline, bool isError)
+		{
+			size_t need = data.size() + (newline ? 1 : 0);
+			fileBytes_ += need;
+			if (buffer_.size() + need > bufferSize_ && !buffer_.empty())
+				Flush();
+			if (buffer_.empty())
+				firstBuffered_ = TimeService::MonotonicNs();
+			buffer_.append(data.data(), data.size());
+			bufferedLines_++;
+			if (newline)
+				buffer_.push_back('\n');
+
+			if ((isError && policy_.flushOnError) || buffer_.size() >= policy_.bytes)
+				Flush();
+		}
+
+		bool NeedsRoll(size_t need, int64_t wallNs) const
+		{
+			if (fileBytes_ == 0) return false;
+			if (rotation_.maxFileBytes > 0 && fileBytes_ + need > rotation_.maxFileBytes) return true;
+			return rotation_.maxFileAgeSec > 0 && wallNs - fileStartNs_ >= static_cast<int64_t>(rotation_.maxFileAgeSec) * 1000000000;
+		}
+
+	public:
+		explicit LogFileSink(size_t bufferSize = defaultBufferSize)
+			: LogSink("file"), bufferSize_(bufferSize == 0 ? defaultBufferSize : bufferSize)
+		{
+			buffer_.reserve(bufferSize_);
+		}
+
+		~LogFileSink() override
+		{
+			Close();
+		}
+
+		void SetPath(const std::string& path, const std::string& fileFormat, const std::string& ext = ".txt")
+		{
+			Flush();
+			CloseFile();
+			fileName_.Set(path, fileFormat, ext);
+			currentFile_.clear();
+		}
+
+		void SetPolicy(const LogFlushPolicy& policy)
+		{
+			policy_ = policy;
+		}
+
+		// size / age rolling and the receiver of closed files, nullptr turns rotation off
+		void SetRotation(std::shared_ptr<LogRotator> rotator)
+		{
+			rotator_ = std::move(rotator);
+			rotation_ = rotator_ ? rotator_->GetPolicy() : LogRotationPolicy();
+		}
+
+		// LogBinary records instead of text lines, the path extension should be .nlog
+		void SetBinary(bool binary) { binary_ = binary; }
+
+		const LogFlushPolicy& GetPolicy() const { return policy_; }
+		const std::string& GetCurrentFile() const { return currentFile_; }
+		uint64_t WriteErrors() const { return writeErrors_; }
+		size_t Buffered() const { return buffer_.size(); }
+		uint64_t FileBytes() const { return fileBytes_; }
+
+		// switches the file if wallNs crossed the name boundary or a rotation limit, true if a new file was started
+		bool Roll(size_t need, int64_t wallNs)
+		{
+			if (fileName_.Update(wallNs))
+			{
+				Finish();
+				SwitchTo(rotator_ ? fileName_.WriteIndex() : 0, wallNs);
+				return true;
+			}
+			if (rotation_.Rolls() && NeedsRoll(need, wallNs))
+			{
+				Finish();
+				SwitchTo(index_ + 1, wallNs);
+				return true;
+			}
+			return false;
+		}
+
+		// adds one line, the file is switched first if needed
+		void Append(std::string_view line, int64_t wallNs, bool isError = false)
+		{
+			Roll(line.size() + 1, wallNs);
+			Buffer(line, true, isError);
+		}
+
+		bool NeedsText() const override { return !binary_; }
+
+		// no text in binary mode, the definitions a record needs go in front of it
+		void Write(const LogRecord& rec, std::string_view line) override
+		{
+			bool isError = rec.type == LogType::error;
+			if (!binary_)
+			{
+				Append(line, rec.timestamp, isError);
+				return;
+			}
+			binBuf_.clear();
+			if (Roll(rec.size + 64, rec.timestamp))
+				encoder_.Begin(binBuf_, fileBytes_ == 0);
+			encoder_.Encode(rec, binBuf_);
+			Buffer(binBuf_, false, isError);
+		}
+
+		void EndBatch() override
+		{
+			if (policy_.intervalMs <= 0)
+				Flush();
+			else
+				FlushIfDue();
+		}
+
+		// one write for everything buffered
+		void Flush() override
+		{
+			if (buffer_.empty()) return;
+
+			if (!Open() || !WriteAll(buffer_.data(), buffer_.size()))
+			{
+				writeErrors_++;
+				dropped_.fetch_add(bufferedLines_, std::memory_order_relaxed);
+				std::cerr << "Cannot output log string : " << currentFile_ << std::endl;
+				CloseFile();	// reopen on the next flush
+			}
+			bufferedLines_ = 0;
+			buffer_.clear();	// on failure the batch is dropped, the buffer must not grow without bound
+		}
+
+		// flush if the oldest line waited intervalMs, returns ns until that happens (-1 nothing buffered)
+		int64_t FlushIfDue() override
+		{
+			if (buffer_.empty()) return -1;
+			int64_t interval = static_cast<int64_t>(policy_.intervalMs) * 1000000;
+			int64_t elapsed = TimeService::MonotonicNs() - firstBuffered_;
+			if (elapsed >= interval)
+			{
+				Flush();
+				return -1;
+			}
+			return interval - elapsed;
+		}
+
+		void CloseFile()
+		{
+			if (fd_ < 0) return;
+#ifdef _WIN32
+			_close(fd_);
+#else
+			::close(fd_);
+#endif
+			fd_ = -1;
+		}
+
+		void Close()
+		{
+			Flush();
+			CloseFile();
+		}
+
+		void Stop() override { Close(); }
+	};
+}
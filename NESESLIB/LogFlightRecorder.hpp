@@ -0,0 +1,313 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "LogRecord.hpp"
+#include "LogLevel.hpp"
+#include "TimeService.hpp"
+
+/*
+Flight recorder, the recent log records that were below the output level.
+
+Every thread gets a fixed ring of LogFlightSlots records, a record filtered out by the level check
+but at or above the recorder level is copied there (one memcpy, no formatting, no allocation) and
+overwrites the oldest one. The Logger writes the rings to its sinks before an error line and on
+Logger::DumpFlightRecorder; InstallCrashHandler writes them to a file from the fatal signal handler.
+
+	Logger::Instance().SetLevel(LogType::info);
+	Logger::Instance().SetFlightRecorder(LogType::trace);		// trace / debug kept in memory only
+	LogFlightRecorder::Instance().InstallCrashHandler("/var/log/app/crash.txt");
+
+Macros removed at compile time (NESES_LOG_MIN_LEVEL) are not recorded either.
+*/
+
+namespace NESES
+{
+	constexpr size_t LogFlightSlots = 256;			// records per thread
+	constexpr size_t LogFlightMaxThreads = 256;		// threads without a ring record nothing
+
+	// seqlock slot, seq is odd while the owner thread writes the record
+	struct LogFlightSlot
+	{
+		std::atomic<uint32_t> seq{ 0 };
+		LogRecord rec;
+	};
+
+	// ring of one thread, kept after the thread exits and given to the next new thread
+	struct LogFlightRing
+	{
+		std::atomic<uint64_t> head{ 0 };		// records written so far
+		std::atomic<bool> inUse{ false };
+		uint64_t dumped{ 0 };					// head at the last Collect, logger thread only
+		LogFlightSlot slots[LogFlightSlots];
+
+		// owner thread
+		void Write(const LogRecord& rec)
+		{
+			uint64_t h = head.load(std::memory_order_relaxed);
+			LogFlightSlot& slot = slots[h % LogFlightSlots];
+			uint32_t s = slot.seq.load(std::memory_order_relaxed);
+			slot.seq.store(s + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			std::memcpy(&slot.rec, &rec, sizeof(LogRecord));
+			slot.seq.store(s + 2, std::memory_order_release);
+			head.store(h + 1, std::memory_order_release);
+		}
+
+		// any thread, false if the slot was being written or was overwritten meanwhile
+		bool Read(uint64_t index, LogRecord& out) const
+		{
+			const LogFlightSlot& slot = slots[index % LogFlightSlots];
+			uint32_t s = slot.seq.load(std::memory_order_acquire);
+			if (s & 1) return false;
+			std::memcpy(&out, &slot.rec, sizeof(LogRecord));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return slot.seq.load(std::memory_order_relaxed) == s;
+		}
+	};
+
+	class LogFlightRecorder
+	{
+	private:
+		static constexpr int disabled = NESES_LOG_LEVEL_ERROR + 1;
+
+		std::atomic<int> minSeverity_{ disabled };
+		std::atomic<LogFlightRing*> rings_[LogFlightMaxThreads]{};	// never freed, read by the signal handler
+		std::atomic<size_t> ringCount_{ 0 };
+		char crashPath_[512]{};
+
+		LogFlightRecorder() = default;
+
+		// fixed buffer output for FormatLogLine, nothing allocated in the signal handler
+		struct FixedLine
+		{
+			char data[1024];
+			size_t size{ 0 };
+
+			void append(const char* p, size_t n)
+			{
+				if (n > sizeof(data) - size) n = sizeof(data) - size;
+				std::memcpy(data + size, p, n);
+				size += n;
+			}
+		};
+
+		LogFlightRing* Claim()
+		{
+			size_t count = ringCount_.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; i++)
+			{
+				LogFlightRing* ring = rings_[i].load(std::memory_order_acquire);
+				bool expected = false;
+				if (ring && ring->inUse.compare_exchange_strong(expected, true))
+					return ring;
+			}
+			size_t index = ringCount_.fetch_add(1);
+			if (index >= LogFlightMaxThreads)
+			{
+				ringCount_.store(LogFlightMaxThreads);
+				return nullptr;
+			}
+			LogFlightRing* ring = new LogFlightRing();
+			ring->inUse.store(true);
+			rings_[index].store(ring, std::memory_order_release);
+			return ring;
+		}
+
+		LogFlightRing* LocalRing()
+		{
+			struct LocalHandle
+			{
+				LogFlightRing* ring{ nullptr };
+				bool claimed{ false };
+				~LocalHandle()
+				{
+					if (ring)
+						ring->inUse.store(false, std::memory_order_release);
+				}
+			};
+			thread_local LocalHandle handle;
+
+			if (!handle.claimed)
+			{
+				handle.ring = Claim();
+				handle.claimed = true;
+			}
+			return handle.ring;
+		}
+
+		// ring order from index from up to head, older records are already overwritten
+		template <typename F>
+		static void ForEachRecord(const LogFlightRing& ring, uint64_t from, uint64_t head, F&& f)
+		{
+			if (head - from > LogFlightSlots || from > head)
+				from = head > LogFlightSlots ? head - LogFlightSlots : 0;
+			LogRecord rec;
+			for (uint64_t i = from; i < head; i++)
+			{
+				if (ring.Read(i, rec))
+					f(rec);
+			}
+		}
+
+		static void WriteFd(int fd, const char* p, size_t n)
+		{
+			while (n > 0)
+			{
+#ifdef _WIN32
+				int w = _write(fd, p, static_cast<unsigned int>(n));
+#else
+				ssize_t w = ::write(fd, p, n);
+#endif
+				if (w <= 0) return;
+				p += w;
+				n -= static_cast<size_t>(w);
+			}
+		}
+
+		static void OnFatalSignal(int sig)
+		{
+			Instance().DumpToFile(Instance().crashPath_);
+			std::signal(sig, SIG_DFL);
+			std::raise(sig);
+		}
+
+	public:
+		LogFlightRecorder(const LogFlightRecorder&) = delete;
+		LogFlightRecorder& operator=(const LogFlightRecorder&) = delete;
+
+		static LogFlightRecorder& Instance()
+		{
+			static LogFlightRecorder instance;
+			return instance;
+		}
+
+		// records below the output level and at or above lt are kept, see Logger::SetFlightRecorder
+		void SetLevel(LogType lt) { minSeverity_.store(LogSeverity(lt), std::memory_order_relaxed); }
+		void Disable() { minSeverity_.store(disabled, std::memory_order_relaxed); }
+		bool IsEnabled() const { return minSeverity_.load(std::memory_order_relaxed) != disabled; }
+
+		// macro fast path, one relaxed load; levels compiled out are not recorded either
+		bool Captures(LogType lt) const
+		{
+			return LogCompiledIn(lt) && LogSeverity(lt) >= minSeverity_.load(std::memory_order_relaxed);
+		}
+
+		// text longer than the payload is cut, the recorder does not allocate
+		void Record(const LogCallsite& callsite, std::string_view msg, LogType lt)
+		{
+			LogFlightRing* ring = LocalRing();
+			if (!ring) return;
+			LogRecord rec;
+			rec.Reset(lt, TimeService::NowNs());
+			rec.callsite = &callsite;
+			if (msg.size() > LogRecord::PayloadSize)
+			{
+				msg = msg.substr(0, LogRecord::PayloadSize);
+				rec.flags |= LogRecord::flagTruncated;
+			}
+			rec.SetText(msg.data(), msg.size());
+			ring->Write(rec);
+		}
+
+		template <typename... Args>
+		void Recordf(const LogCallsite& callsite, LogType lt, const Args&... args)
+		{
+			LogFlightRing* ring = LocalRing();
+			if (!ring) return;
+			LogRecord rec;
+			rec.Reset(lt, TimeService::NowNs());
+			rec.callsite = &callsite;
+			(rec.Append(args), ...);
+			ring->Write(rec);
+		}
+
+		// records of all threads by time; sinceLastCollect skips the ones an earlier call returned
+		void Collect(std::vector<LogRecord>& out, bool sinceLastCollect)
+		{
+			size_t count = std::min(ringCount_.load(std::memory_order_acquire), LogFlightMaxThreads);
+			for (size_t i = 0; i < count; i++)
+			{
+				LogFlightRing* ring = rings_[i].load(std::memory_order_acquire);
+				if (!ring) continue;
+				uint64_t head = ring->head.load(std::memory_order_acquire);
+				ForEachRecord(*ring, sinceLastCollect ? ring->dumped : 0, head, [&out](const LogRecord& rec)
+					{
+						out.push_back(rec);
+					});
+				ring->dumped = head;
+			}
+			std::stable_sort(out.begin(), out.end(), [](const LogRecord& a, const LogRecord& b) { return a.timestamp < b.timestamp; });
+		}
+
+		/*
+		Writes every ring to path, async signal safe: open / write only, thread by thread, UTC epoch time.
+		Text is cut at 1KB per line.
+		*/
+		void DumpToFile(const char* path)
+		{
+			if (!path || !*path) return;
+#ifdef _WIN32
+			int fd = _open(path, _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+			int fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+			if (fd < 0) return;
+
+			static const char head[] = "----- flight recorder -----\n";
+			WriteFd(fd, head, sizeof(head) - 1);
+			size_t count = std::min(ringCount_.load(std::memory_order_acquire), LogFlightMaxThreads);
+			for (size_t i = 0; i < count; i++)
+			{
+				LogFlightRing* ring = rings_[i].load(std::memory_order_acquire);
+				if (!ring) continue;
+				ForEachRecord(*ring, 0, ring->head.load(std::memory_order_acquire), [fd](const LogRecord& rec)
+					{
+						// seconds.nanoseconds, local time conversion is not signal safe
+						char ts[40];
+						auto res = std::to_chars(ts, ts + 20, rec.timestamp / 1000000000);
+						*res.ptr++ = '.';
+						int64_t ns = rec.timestamp % 1000000000;
+						for (int64_t div = 100000000; div > 0; div /= 10)
+							*res.ptr++ = static_cast<char>('0' + (ns / div) % 10);
+
+						FixedLine line;
+						FormatLogLine(rec, std::string_view(ts, static_cast<size_t>(res.ptr - ts)), line);
+						if (line.size == sizeof(line.data)) line.size--;
+						line.data[line.size++] = '\n';
+						WriteFd(fd, line.data, line.size);
+					});
+			}
+#ifdef _WIN32
+			_close(fd);
+#else
+			::close(fd);
+#endif
+		}
+
+		// SIGSEGV, SIGABRT, SIGFPE, SIGILL (SIGBUS) dump the rings to path, then the default action runs
+		bool InstallCrashHandler(const std::string& path)
+		{
+			if (path.empty() || path.size() >= sizeof(crashPath_)) return false;
+			std::memcpy(crashPath_, path.c_str(), path.size() + 1);
+			for (int sig : { SIGSEGV, SIGABRT, SIGFPE, SIGILL })
+				std::signal(sig, &LogFlightRecorder::OnFatalSignal);
+#ifdef SIGBUS
+			std::signal(SIGBUS, &LogFlightRecorder::OnFatalSignal);
+#endif
+			return true;
+		}
+	};
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "LogRecord.hpp"
+
+/*
+Log level filtering.
+
+Compile time : NESES_LOG_MIN_LEVEL (one of the NESES_LOG_LEVEL_* values) removes lower level macros,
+               NESESLOG_TRACE / NESESLOG_DEBUG expand to nothing, the generic macros fold to dead code.
+Runtime      : a global minimum and one per module tag. A translation unit picks its tag by defining
+               NESES_LOG_TAG before including Logger.hpp, every macro call site caches the level of its
+               tag, so the check is two relaxed loads before the message expression is evaluated.
+
+	#define NESES_LOG_TAG "tcp"
+	#include "Neses/Logger.hpp"
+	...
+	Logger::Instance().SetLevel("tcp", LogType::debug);
+*/
+
+#define NESES_LOG_LEVEL_TRACE		0
+#define NESES_LOG_LEVEL_DEBUG		1
+#define NESES_LOG_LEVEL_INFO		2
+#define NESES_LOG_LEVEL_USEREVENT	3
+#define NESES_LOG_LEVEL_WARNING		4
+#define NESES_LOG_LEVEL_ERROR		5
+
+#ifndef NESES_LOG_MIN_LEVEL
+#define NESES_LOG_MIN_LEVEL NESES_LOG_LEVEL_TRACE
+#endif
+
+#ifndef NESES_LOG_TAG
+#define NESES_LOG_TAG ""
+#endif
+
+namespace NESES
+{
+	constexpr int LogSeverity(LogType lt)
+	{
+		switch (lt)
+		{
+		case LogType::trace: return NESES_LOG_LEVEL_TRACE;
+		case LogType::debug: return NESES_LOG_LEVEL_DEBUG;
+		case LogType::userevent: return NESES_LOG_LEVEL_USEREVENT;
+		case LogType::warning: return NESES_LOG_LEVEL_WARNING;
+		case LogType::error: return NESES_LOG_LEVEL_ERROR;
+		case LogType::info:
+		default: return NESES_LOG_LEVEL_INFO;
+		}
+	}
+
+	// compile time part of the check, constant folded when lt is a constant
+	constexpr bool LogCompiledIn(LogType lt)
+	{
+		return LogSeverity(lt) >= NESES_LOG_MIN_LEVEL;
+	}
+
+	class LogLevels
+	{
+	private:
+		std::atomic<int> minSeverity_{ NESES_LOG_LEVEL_TRACE };
+		std::atomic<uint32_t> epoch_{ 1 };			// bumped on every change, call sites compare it with their copy
+		std::map<std::string, int> tagSeverity_;
+		mutable std::mutex tagLock;
+
+		LogLevels() = default;
+
+		// slow path, once per call site and level change
+		int Resolve(const char* tag) const
+		{
+			if (tag && *tag)
+			{
+				std::lock_guard<std::mutex> lock(tagLock);
+				auto it = tagSeverity_.find(tag);
+				if (it != tagSeverity_.end())
+					return it->second;
+			}
+			return minSeverity_.load(std::memory_order_relaxed);
+		}
+
+	public:
+		LogLevels(const LogLevels&) = delete;
+		LogLevels& operator=(const LogLevels&) = delete;
+
+		static LogLevels& Instance()
+		{
+			static LogLevels instance;
+			return instance;
+		}
+
+		void SetLevel(LogType lt)
+		{
+			minSeverity_.store(LogSeverity(lt), std::memory_order_relaxed);
+			epoch_.fetch_add(1, std::memory_order_release);
+		}
+
+		void SetLevel(const std::string& tag, LogType lt)
+		{
+			{
+				std::lock_guard<std::mutex> lock(tagLock);
+				tagSeverity_[tag] = LogSeverity(lt);
+			}
+			epoch_.fetch_add(1, std::memory_order_release);
+		}
+
+		// tag follows the global level again
+		void ClearLevel(const std::string& tag)
+		{
+			{
+				std::lock_guard<std::mutex> lock(tagLock);
+				tagSeverity_.erase(tag);
+			}
+			epoch_.fetch_add(1, std::memory_order_release);
+		}
+
+		// global level only, for calls without a call site (Logger::log called directly)
+		bool IsEnabled(LogType lt) const
+		{
+			return LogCompiledIn(lt) && LogSeverity(lt) >= minSeverity_.load(std::memory_order_relaxed);
+		}
+
+		bool IsEnabled(const LogCallsite& cs, LogType lt) const
+		{
+			if (!LogCompiledIn(lt)) return false;
+			// acquire pairs with the release of SetLevel, the new epoch comes with the new levels
+			uint32_t epoch = epoch_.load(std::memory_order_acquire);
+			if (cs.levelEpoch.load(std::memory_order_acquire) != epoch)
+			{
+				cs.minSeverity.store(Resolve(cs.tag), std::memory_order_relaxed);
+				cs.levelEpoch.store(epoch, std::memory_order_release);	// after minSeverity
+			}
+			return LogSeverity(lt) >= cs.minSeverity.load(std::memory_order_relaxed);
+		}
+	};
+}
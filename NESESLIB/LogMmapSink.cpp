@@ -0,0 +1,142 @@
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "LogMmapSink.hpp"
+
+// windows.h and the posix headers stay inside the library, clients of Logger.hpp do not get them
+
+#ifndef _WIN32
+// real blocks for the whole segment; a sparse file (ftruncate) would take SIGBUS on a full device
+static int Preallocate(int fd, size_t size)
+{
+#if defined(__linux__)
+	return fallocate(fd, 0, 0, static_cast<off_t>(size));
+#elif defined(__APPLE__)
+	(void)fd;
+	(void)size;
+	errno = ENOTSUP;
+	return -1;
+#else
+	int rc = posix_fallocate(fd, 0, static_cast<off_t>(size));
+	if (rc != 0) errno = rc;
+	return rc == 0 ? 0 : -1;
+#endif
+}
+#endif
+
+NESESAPI bool NESES::MapLogSegment(const std::string& path, size_t minSize, LogMappedFile& seg, size_t& existing)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	seg.file = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) return false;
+	existing = static_cast<size_t>(size.QuadPart);
+	seg.size = existing > minSize ? existing : minSize;
+	// mapping a section larger than the file extends the file, this is the preallocation
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(static_cast<uint64_t>(seg.size) >> 32), static_cast<DWORD>(seg.size & 0xFFFFFFFFu), nullptr);
+	if (!mapping) return false;
+	seg.mapping = mapping;
+	seg.base = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, seg.size));
+	return seg.base != nullptr;
+#else
+	seg.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (seg.fd < 0) return false;
+	struct stat st;
+	if (fstat(seg.fd, &st) != 0) return false;
+	existing = static_cast<size_t>(st.st_size);
+	seg.size = existing > minSize ? existing : minSize;
+	if (Preallocate(seg.fd, seg.size) != 0) return false;
+	void* p = mmap(nullptr, seg.size, PROT_READ | PROT_WRITE, MAP_SHARED, seg.fd, 0);
+	if (p == MAP_FAILED) return false;
+	seg.base = static_cast<char*>(p);
+	return true;
+#endif
+}
+
+NESESAPI bool NESES::UnmapLogSegment(LogMappedFile& seg, size_t used)
+{
+	bool ok = true;
+#ifdef _WIN32
+	if (seg.base)
+	{
+		FlushViewOfFile(seg.base, 0);
+		UnmapViewOfFile(seg.base);
+	}
+	if (seg.mapping) CloseHandle(static_cast<HANDLE>(seg.mapping));
+	if (seg.file)
+	{
+		LARGE_INTEGER pos;
+		pos.QuadPart = static_cast<LONGLONG>(used);
+		if (seg.base)
+			ok = SetFilePointerEx(static_cast<HANDLE>(seg.file), pos, nullptr, FILE_BEGIN) && SetEndOfFile(static_cast<HANDLE>(seg.file));
+		CloseHandle(static_cast<HANDLE>(seg.file));
+	}
+#else
+	if (seg.base)
+	{
+		msync(seg.base, used, MS_ASYNC);
+		munmap(seg.base, seg.size);
+	}
+	if (seg.fd >= 0)
+	{
+		if (seg.base)
+			ok = ftruncate(seg.fd, static_cast<off_t>(used)) == 0;
+		::close(seg.fd);
+	}
+#endif
+	seg = LogMappedFile();
+	return ok;
+}
+
+NESESAPI void NESES::SyncLogSegment(const LogMappedFile& seg, size_t from, size_t to)
+{
+	if (!seg.base || to <= from) return;
+#ifdef _WIN32
+	FlushViewOfFile(seg.base + from, to - from);
+#else
+	// msync needs a page aligned start
+	static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t start = from - from % page;
+	msync(seg.base + start, to - start, MS_ASYNC);
+#endif
+}
+
+NESESAPI bool NESES::CanPreallocateLog(const std::string& path, std::string& reason)
+{
+#ifdef _WIN32
+	(void)path;
+	(void)reason;
+	return true;		// the file mapping section extends the file
+#else
+	std::string probe = path + ".prealloc";
+	int fd = ::open(probe.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		reason = std::strerror(errno);
+		return false;
+	}
+	bool ok = Preallocate(fd, 64 * 1024) == 0;
+	if (!ok)
+		reason = std::strerror(errno);
+	::close(fd);
+	::unlink(probe.c_str());
+	return ok;
+#endif
+}
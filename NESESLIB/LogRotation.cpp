@@ -0,0 +1,65 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include "LogRotation.hpp"
+
+// boost iostreams stays inside the library, clients of Logger.hpp do not need it
+NESESAPI bool NESES::GzipLogFile(const std::string& src, const std::string& dst, size_t bytesPerSec, const std::atomic<bool>& stop)
+{
+	namespace bio = boost::iostreams;
+	constexpr size_t chunkSize = 64 * 1024;
+	bool complete = false;
+	try
+	{
+		std::ifstream in(src, std::ios::binary);
+		if (!in)
+		{
+			std::cerr << "Cannot open logfile for compression " << src << std::endl;
+			return false;
+		}
+		std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			std::cerr << "Cannot create " << dst << std::endl;
+			return false;
+		}
+		{
+			bio::filtering_ostream zout;
+			zout.push(bio::gzip_compressor());
+			zout.push(out);
+
+			std::vector<char> chunk(chunkSize);
+			uint64_t total = 0;
+			auto start = std::chrono::steady_clock::now();
+			while (!stop.load())
+			{
+				in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+				std::streamsize n = in.gcount();
+				if (n <= 0) break;
+				zout.write(chunk.data(), n);
+				total += static_cast<uint64_t>(n);
+				if (bytesPerSec == 0) continue;
+
+				// spread the disk io, sleep in short steps so Stop is not held up
+				auto due = start + std::chrono::microseconds(total * 1000000 / bytesPerSec);
+				while (!stop.load() && std::chrono::steady_clock::now() < due)
+					std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - std::chrono::steady_clock::now(), std::chrono::milliseconds(100)));
+			}
+			complete = !stop.load() && !in.bad() && zout.good();
+			zout.reset();	// writes the gzip trailer
+		}
+		out.close();
+		complete = complete && !out.fail();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Log compression error : " << src << " : " << e.what() << std::endl;
+		complete = false;
+	}
+	return complete;
+}
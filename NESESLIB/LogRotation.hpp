@@ -0,0 +1,350 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+#include "Exporter.h"
+#include "App.hpp"
+
+/*
+Log file rotation, compression and retention.
+
+The file sinks roll to <path><date>.1.txt, <path><date>.2.txt ... when a file reaches maxFileBytes or
+was written for maxFileAgeSec, besides the date change of the file name format. Every closed file is
+handed to the LogRotator, which gzips it (<file>.gz) and removes the oldest closed files over the
+retention limits, on the io lane. The logger thread only queues the file name.
+
+	LogRotationPolicy rp;
+	rp.maxFileBytes = 256 * 1024 * 1024;
+	rp.compress = true;
+	rp.keepFiles = 30;
+	Logger::Instance().SetRotationPolicy(rp);	// before Init
+*/
+
+namespace NESES
+{
+	// gzips src into dst, read at most bytesPerSec (0 unlimited), gives up when stop is set; false on error or stop
+	NESESAPI bool GzipLogFile(const std::string& src, const std::string& dst, size_t bytesPerSec, const std::atomic<bool>& stop);
+
+	struct LogRotationPolicy
+	{
+		uint64_t maxFileBytes{ 0 };			// start the next file at this size, 0 rolls with the file name format only
+		int maxFileAgeSec{ 0 };				// start the next file after this many seconds, 0 off
+		bool compress{ false };				// gzip closed files
+		size_t keepFiles{ 0 };				// closed files kept, the oldest are removed first, 0 keeps all
+		uint64_t keepBytes{ 0 };			// total size of closed files kept, 0 no limit
+		size_t compressBytesPerSec{ 16 * 1024 * 1024 };	// read rate of the compressor, 0 unlimited
+
+		bool Rolls() const { return maxFileBytes > 0 || maxFileAgeSec > 0; }
+		bool HasWork() const { return compress || keepFiles > 0 || keepBytes > 0; }
+	};
+
+	class LogRotator : public std::enable_shared_from_this<LogRotator>
+	{
+	private:
+		static constexpr size_t maxPending = 4096;
+
+		LogRotationPolicy policy_;
+		std::string dir_;						// directory of the log files
+		std::string prefix_;					// file name part of the log path ("app_" of "logs/app_")
+		std::string fileFormat_;
+		std::string ext_{ ".txt" };
+		std::vector<std::string> active_;		// file names the sinks write to, never touched
+		std::deque<std::string> pending_;		// closed files waiting for the io lane
+		bool scheduled_{ false };				// a job is queued or running
+		std::mutex rotateLock;
+		std::atomic<bool> hasPending_{ false };
+		std::atomic<bool> stopFlag_{ false };
+		std::atomic<uint64_t> compressed_{ 0 };
+		std::atomic<uint64_t> removed_{ 0 };
+
+		static bool EndsWith(std::string_view s, std::string_view end)
+		{
+			return s.size() >= end.size() && s.compare(s.size() - end.size(), end.size(), end) == 0;
+		}
+
+		static size_t FixedDigits(char c)
+		{
+			switch (c)
+			{
+			case 'Y': return 4;
+			case 'j': return 3;
+			case 'y': case 'm': case 'd': case 'H': case 'M': case 'S': case 'I': return 2;
+			default: return 0;
+			}
+		}
+
+		static bool IsNameChar(char c)
+		{
+			return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '+' || c == ':' || c == ' ';
+		}
+
+		// true if s can be a strftime output of fmt, numbers are checked by width, names loosely
+		static bool MatchFormat(std::string_view fmt, std::string_view s)
+		{
+			while (!fmt.empty())
+			{
+				if (fmt[0] != '%' || fmt.size() < 2)
+				{
+					if (s.empty() || s[0] != fmt[0]) return false;
+					fmt.remove_prefix(1);
+					s.remove_prefix(1);
+					continue;
+				}
+				char c = fmt[1];
+				size_t skip = 2;
+				if ((c == 'E' || c == 'O') && fmt.size() > 2)
+				{
+					c = fmt[2];
+					skip = 3;
+				}
+				fmt.remove_prefix(skip);
+				if (c == '%')
+				{
+					if (s.empty() || s[0] != '%') return false;
+					s.remove_prefix(1);
+					continue;
+				}
+				size_t digits = FixedDigits(c);
+				if (digits > 0)
+				{
+					if (s.size() < digits) return false;
+					for (size_t i = 0; i < digits; i++)
+						if (!std::isdigit(static_cast<unsigned char>(s[i]))) return false;
+					s.remove_prefix(digits);
+					continue;
+				}
+				// month names, %F, %T ... any width
+				for (size_t n = 1; n <= s.size() && IsNameChar(s[n - 1]); n++)
+					if (MatchFormat(fmt, s.substr(n))) return true;
+				return false;
+			}
+			return s.empty();
+		}
+
+		// <prefix><file format>[.index]<ext>[.gz]
+		bool IsLogFile(std::string_view name) const
+		{
+			if (name.compare(0, prefix_.size(), prefix_) != 0) return false;
+			name.remove_prefix(prefix_.size());
+			if (EndsWith(name, ".gz")) name.remove_suffix(3);
+			if (!EndsWith(name, ext_)) return false;
+			name.remove_suffix(ext_.size());
+			size_t dot = name.find_last_of('.');
+			if (dot != std::string_view::npos && dot + 1 < name.size()
+				&& std::all_of(name.begin() + dot + 1, name.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; })
+				&& MatchFormat(fileFormat_, name.substr(0, dot)))
+				return true;
+			return MatchFormat(fileFormat_, name);
+		}
+
+		static std::string FileName(const std::string& file)
+		{
+			return std::filesystem::path(file).filename().string();
+		}
+
+		// rotateLock held
+		void ScheduleLocked()
+		{
+			if (!scheduled_ && !pending_.empty() && !stopFlag_.load())
+			{
+				auto self = shared_from_this();
+				auto& executor = App::Instance().GetExecutor(Lane::io);
+				auto task = executor.GetNew("logrotate", [self]() { self->Run(); return BackObject(); });
+				scheduled_ = task && executor.Enqueue(task);
+			}
+			hasPending_.store(!scheduled_ && !pending_.empty());	// refused (queue full), Kick tries again
+		}
+
+		// io lane, one job at a time
+		void Run()
+		{
+			LogRotationPolicy policy;
+			while (!stopFlag_.load())
+			{
+				std::string file;
+				{
+					std::lock_guard<std::mutex> lock(rotateLock);
+					if (pending_.empty()) break;
+					file = std::move(pending_.front());
+					pending_.pop_front();
+					policy = policy_;
+				}
+				if (policy.compress && Compress(file, policy.compressBytesPerSec))
+					compressed_++;
+			}
+			if (!stopFlag_.load())
+				ApplyRetention();
+
+			std::lock_guard<std::mutex> lock(rotateLock);
+			scheduled_ = false;
+			ScheduleLocked();		// queued while retention ran
+		}
+
+		// gzip into <file>.gz.tmp, renamed when complete
+		bool Compress(const std::string& file, size_t bytesPerSec)
+		{
+			std::string gz = file + ".gz";
+			std::string tmp = gz + ".tmp";
+			std::error_code ec;
+			bool complete = GzipLogFile(file, tmp, bytesPerSec, stopFlag_);
+
+			if (!complete)
+			{
+				std::filesystem::remove(tmp, ec);
+				return false;
+			}
+			std::filesystem::rename(tmp, gz, ec);
+			if (ec)
+			{
+				std::cerr << "Cannot rename " << tmp << " : " << ec.message() << std::endl;
+				std::filesystem::remove(tmp, ec);
+				return false;
+			}
+			std::filesystem::remove(file, ec);
+			return true;
+		}
+
+		// closed log files of this logger, oldest first, removed while over keepFiles / keepBytes
+		void ApplyRetention()
+		{
+			namespace fs = std::filesystem;
+			LogRotationPolicy policy;
+			std::vector<std::string> active;
+			{
+				std::lock_guard<std::mutex> lock(rotateLock);
+				policy = policy_;
+				active = active_;
+			}
+			if (policy.keepFiles == 0 && policy.keepBytes == 0) return;
+
+			struct Entry
+			{
+				fs::path path;
+				uint64_t size;
+				fs::file_time_type mtime;
+			};
+			std::vector<Entry> files;
+			uint64_t total = 0;
+			std::error_code ec;
+			for (fs::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec))
+			{
+				std::string name = it->path().filename().string();
+				if (!IsLogFile(name) || std::find(active.begin(), active.end(), name) != active.end())
+					continue;
+				std::error_code fec;
+				if (!it->is_regular_file(fec)) continue;
+				Entry e{ it->path(), static_cast<uint64_t>(it->file_size(fec)), it->last_write_time(fec) };
+				if (fec) continue;
+				total += e.size;
+				files.push_back(std::move(e));
+			}
+
+			std::sort(files.begin(), files.end(), [](const Entry& a, const Entry& b)
+				{
+					return a.mtime != b.mtime ? a.mtime < b.mtime : a.path < b.path;
+				});
+			size_t count = files.size();
+			for (const auto& e : files)
+			{
+				if (!((policy.keepFiles > 0 && count > policy.keepFiles) || (policy.keepBytes > 0 && total > policy.keepBytes)))
+					break;
+				if (fs::remove(e.path, ec))
+					removed_++;
+				count--;
+				total -= e.size;
+			}
+		}
+
+	public:
+		LogRotator() = default;
+		LogRotator(const LogRotator&) = delete;
+		LogRotator& operator=(const LogRotator&) = delete;
+
+		void SetPolicy(const LogRotationPolicy& policy)
+		{
+			std::lock_guard<std::mutex> lock(rotateLock);
+			policy_ = policy;
+		}
+
+		LogRotationPolicy GetPolicy()
+		{
+			std::lock_guard<std::mutex> lock(rotateLock);
+			return policy_;
+		}
+
+		// same arguments as LogFileName::Set
+		void SetPath(const std::string& path, const std::string& fileFormat, const std::string& ext = ".txt")
+		{
+			std::filesystem::path p(path + "x");	// "logs/" and "logs/app_" both name a file prefix
+			std::lock_guard<std::mutex> lock(rotateLock);
+			dir_ = p.parent_path().string();
+			if (dir_.empty()) dir_ = ".";
+			prefix_ = p.filename().string();
+			prefix_.pop_back();
+			fileFormat_ = fileFormat;
+			ext_ = ext;
+			active_.clear();
+		}
+
+		// logger thread, a sink started writing file
+		void Opened(const std::string& file)
+		{
+			std::string name = FileName(file);
+			std::lock_guard<std::mutex> lock(rotateLock);
+			if (std::find(active_.begin(), active_.end(), name) == active_.end())
+				active_.push_back(std::move(name));
+		}
+
+		// logger thread, file is closed for good, compression and retention run on the io lane
+		void Finished(const std::string& file)
+		{
+			std::string name = FileName(file);
+			std::lock_guard<std::mutex> lock(rotateLock);
+			active_.erase(std::remove(active_.begin(), active_.end(), name), active_.end());
+			if (!policy_.HasWork()) return;
+			if (pending_.size() >= maxPending)
+			{
+				std::cerr << "Log rotation queue full, " << file << " is left as is" << std::endl;
+				return;
+			}
+			pending_.push_back(file);
+			ScheduleLocked();
+		}
+
+		// logger thread, retries a job the io lane refused, never waits for the lock
+		void Kick()
+		{
+			if (!hasPending_.load(std::memory_order_relaxed)) return;
+			std::unique_lock<std::mutex> lock(rotateLock, std::try_to_lock);
+			if (lock.owns_lock())
+				ScheduleLocked();
+		}
+
+		// aborts a running compression (the original file stays), queued files wait for Start
+		void Stop()
+		{
+			stopFlag_.store(true);
+		}
+
+		void Start()
+		{
+			stopFlag_.store(false);
+			std::lock_guard<std::mutex> lock(rotateLock);
+			ScheduleLocked();
+		}
+
+		uint64_t CompressedCount() const { return compressed_.load(); }
+		uint64_t RemovedCount() const { return removed_.load(); }
+	};
+}
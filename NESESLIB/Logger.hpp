@@ -1,253 +1,623 @@
 ﻿#pragma once
 #include <iostream>
-#include <fstream>	    // std::ofstream
 #include <sstream>		// std::ostringstream
 #include <string>
 #include <chrono>
-#include <ctime>		// std::strftime, std::time_t, std::tm, std::localtime (not thread safe)
-#include <time.h>		// localtime_r (windows) localtime_s (posix)
+#include <charconv>		// std::to_chars
+#include <type_traits>
+#include <ctime>		// std::time_t
 #include <condition_variable>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <unordered_set>
 #include "NesesThread.hpp"
-#include "QueueFifoWaitable.hpp"
-#include "CallBack.hpp"
+#include "QueueFifoSPSC.hpp"
+#include "LogRecord.hpp"
+#include "LogLevel.hpp"
+#include "TimeService.hpp"
+#include "LogSink.hpp"
+#include "LogFileSink.hpp"
+#include "LogMmapSink.hpp"
+#include "LogRotation.hpp"
+#include "LogFlightRecorder.hpp"
+#include "LogRateLimit.hpp"
 #include "App.hpp"					// todo !!! circular header include with app
 
 
+// every macro call site has a static LogCallsite, the level check runs before the message expression is evaluated
+// filtered records go to the flight recorder when it takes their level, the rate limit is checked after the level
+#define NESES_LOG_TEXT_(lt, withloc, msg) \
+	do { \
+		static const NESES::LogCallsite nesesLogCallsite_{ nullptr, __FILE__, __func__, __LINE__, withloc, NESES_LOG_TAG }; \
+		if (NESES::LogLevels::Instance().IsEnabled(nesesLogCallsite_, lt)) \
+		{ \
+			if (NESES::LogRateLimiter::Instance().Allow(nesesLogCallsite_)) \
+				NESES::Logger::Instance().log(nesesLogCallsite_, msg, lt); \
+		} \
+		else if (NESES::LogFlightRecorder::Instance().Captures(lt)) \
+			NESES::LogFlightRecorder::Instance().Record(nesesLogCallsite_, msg, lt); \
+	} while (0)
+
+#define NESES_LOG_FORMAT_(lt, withloc, fmt, ...) \
+	do { \
+		static const NESES::LogCallsite nesesLogCallsite_{ fmt, __FILE__, __func__, __LINE__, withloc, NESES_LOG_TAG }; \
+		if (NESES::LogLevels::Instance().IsEnabled(nesesLogCallsite_, lt)) \
+		{ \
+			if (NESES::LogRateLimiter::Instance().Allow(nesesLogCallsite_)) \
+				NESES::Logger::Instance().logf(nesesLogCallsite_, lt, ##__VA_ARGS__); \
+		} \
+		else if (NESES::LogFlightRecorder::Instance().Captures(lt)) \
+			NESES::LogFlightRecorder::Instance().Recordf(nesesLogCallsite_, lt, ##__VA_ARGS__); \
+	} while (0)
+
 // developer log macros
 #define NESESDLOG(msg) \
-    NESES::Logger::Instance().log(__FILE__, __func__, __LINE__, msg, NESES::LogType::info)
+    NESES_LOG_TEXT_(NESES::LogType::info, true, msg)
 
 #define NESESDLOG_ERROR(msg) \
-    NESES::Logger::Instance().log(__FILE__, __func__, __LINE__, msg, NESES::LogType::error)
+    NESES_LOG_TEXT_(NESES::LogType::error, true, msg)
 
 #define NESESDLOG_WARN(msg) \
-    NESES::Logger::Instance().log(__FILE__, __func__, __LINE__, msg, NESES::LogType::warning)
+    NESES_LOG_TEXT_(NESES::LogType::warning, true, msg)
 
 
 // standard log macros
 #define NESESLOG(msg) \
-    NESES::Logger::Instance().log(msg, NESES::LogType::info)
+    NESES_LOG_TEXT_(NESES::LogType::info, false, msg)
 
 #define NESESLOG_ERROR(msg) \
-    NESES::Logger::Instance().log(msg, LogType::error)
+    NESES_LOG_TEXT_(NESES::LogType::error, false, msg)
 
 #define NESESLOG_WARN(msg) \
-    NESES::Logger::Instance().log(msg, LogType::warning)
+    NESES_LOG_TEXT_(NESES::LogType::warning, false, msg)
 
 #define NESESLOG_UEVENT(msg) \
-    NESES::Logger::Instance().log(msg, LogType::userevent)
+    NESES_LOG_TEXT_(NESES::LogType::userevent, false, msg)
+
+// debug / trace macros expand to nothing below NESES_LOG_MIN_LEVEL
+#if NESES_LOG_MIN_LEVEL <= NESES_LOG_LEVEL_DEBUG
+#define NESESLOG_DEBUG(msg) NESES_LOG_TEXT_(NESES::LogType::debug, false, msg)
+#define NESESDLOG_DEBUG(msg) NESES_LOG_TEXT_(NESES::LogType::debug, true, msg)
+#else
+#define NESESLOG_DEBUG(msg) ((void)0)
+#define NESESDLOG_DEBUG(msg) ((void)0)
+#endif
+
+#if NESES_LOG_MIN_LEVEL <= NESES_LOG_LEVEL_TRACE
+#define NESESLOG_TRACE(msg) NESES_LOG_TEXT_(NESES::LogType::trace, false, msg)
+#define NESESDLOG_TRACE(msg) NESES_LOG_TEXT_(NESES::LogType::trace, true, msg)
+#else
+#define NESESLOG_TRACE(msg) ((void)0)
+#define NESESDLOG_TRACE(msg) ((void)0)
+#endif
 
-// log stream macro
+// deferred formatting macros, "{}" placeholders, arguments are captured raw and formatted by the logger thread
+#define NESESLOGF(lt, fmt, ...) \
+	NESES_LOG_FORMAT_(lt, false, fmt, ##__VA_ARGS__)
+
+#define NESESDLOGF(lt, fmt, ...) \
+	NESES_LOG_FORMAT_(lt, true, fmt, ##__VA_ARGS__)
+
+// log stream macro, a filtered level skips the whole << chain
 #define NESESLOG_STREAM(lt) \
-    NESES::Logger::Instance().log(lt)
+	if (static const NESES::LogCallsite nesesLogCallsite_{ nullptr, __FILE__, __func__, __LINE__, false, NESES_LOG_TAG }; \
+		!NESES::LogLevels::Instance().IsEnabled(nesesLogCallsite_, lt) || !NESES::LogRateLimiter::Instance().Allow(nesesLogCallsite_)) {} \
+	else NESES::Logger::Instance().log(nesesLogCallsite_, lt)
 
 namespace NESES
 {
 
-	constexpr int MaxLogQueueSize = 255;
+	constexpr int MaxLogQueueSize = 1024;				// records per producer thread
+	constexpr size_t MaxLogBatch = 1024;				// records handled between sink EndBatch calls
+	constexpr int64_t LogDropReportNs = 1000000000;		// countAndDrop summary line interval
 
-	enum class LogType
+	// what a producer does when its ring is full
+	enum class LogOverflowPolicy
 	{
-		info,
-		error,
-		warning,
-		userevent
+		block,			// wait for room, only while the logger thread runs
+		drop,			// discard the record
+		countAndDrop	// discard the record, the logger writes "N messages dropped" once a second
+	};
+
+	// records of one producer thread, pushed only by that thread and read only by the logger thread
+	struct LogThreadBuffer
+	{
+		SPSCFifoQueue<LogRecord, MaxLogQueueSize> ring;
+		alignas(64) std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<bool> orphaned{ false };		// thread exited, removed once drained
 	};
 
 	
-	// todo flush logs yok mu
 	class Logger
 	{
 	private:
 		std::string logPath_;
 		std::string logTimeFormat_{ "[%Y-%m-%d %H:%M:%S]" };
 		std::string logFileFormat_{ "%Y-%m-%d" };
-		std::string logFile_;
-		std::string currentFile_;
+		CachedTimeFormat logTimeCache_;		// consumer thread only
+		bool preciseTime_{ false };			// time format shows fractions, coarse clock is not enough
 		bool sinkConsole{ true };
 		bool sinkFile{ true };
-		std::ofstream  ofs;
+		std::shared_ptr<LogFileSink> fileSink_{ std::make_shared<LogFileSink>() };
+		std::shared_ptr<LogMmapSink> mmapSink_;		// replaces fileSink_ when UseMappedFile was called
+		std::shared_ptr<LogConsoleSink> consoleSink_{ std::make_shared<LogConsoleSink>() };
+		std::shared_ptr<LogRotator> rotator_{ std::make_shared<LogRotator>() };
+		bool binaryFile_{ false };			// file output is LogBinary encoded (.nlog), see UseBinaryFile
+		std::vector<std::shared_ptr<LogSink>> extraSinks_;		// AddSink
+		std::vector<std::shared_ptr<LogSink>> sinks_;			// outputs of this run, built by Init
 		bool isStarted;
 		std::shared_ptr<NesesThread> consumerTh_;
-		CallBack<const std::string&> cbLog_;
-		QueueFifoWaitable<std::string> logQueue_;
-		std::function<void(std::string)> logHandler_;
+		std::vector<std::shared_ptr<LogThreadBuffer>> buffers_;		// registry, guarded by registryLock
+		std::mutex registryLock;
+		std::atomic<uint64_t> registryVersion_{ 0 };
+		std::atomic<LogOverflowPolicy> overflowPolicy_{ LogOverflowPolicy::countAndDrop };
+		std::atomic<bool> closed_{ false };			// stop flag seen, producers are refused
+		std::atomic<bool> consuming_{ false };		// logger thread runs, block policy may wait
+		std::atomic<bool> sleeping_{ false };		// logger thread is about to wait on wakeCv
+		std::atomic<std::thread::id> consumerId_{};
+		std::atomic<uint64_t> droppedTotal_{ 0 };
+		std::mutex wakeLock;
+		std::condition_variable wakeCv;
+		uint64_t pendingDropped_{ 0 };				// consumer thread only
+		uint64_t lastVersion_{ UINT64_MAX };
+		int64_t lastDropReport_{ 0 };
+		std::atomic<bool> flightDumpOnError_{ true };
+		std::atomic<bool> flightDumpRequested_{ false };
+		std::vector<LogRecord> flightRecs_;			// consumer thread only
+		std::atomic<bool> collapseRepeats_{ false };
+		LogRecord lastRec_;							// consumer thread, header and payload of the last record written
+		bool hasLast_{ false };
+		bool lastHasLong_{ false };
+		std::string lastLong_;
+		uint64_t repeats_{ 0 };						// records equal to lastRec_ not written
+		int64_t repeatStart_{ 0 };
+		int64_t lastRateReport_{ 0 };
+		std::vector<std::pair<LogRateLimiter::Suppressed, uint32_t>> suppressed_;
+		std::unordered_set<std::string> locations_;		// file / func names of log(codefile, funcname, ...), guarded by locationLock
+		std::mutex locationLock;
 
-		std::string timeStr(const std::string& strFormat)
+		// a copy kept until the end, records, the rate limit and the binary sink hold it by pointer;
+		// the same text gets the same pointer
+		const char* Location(const char* s)
 		{
-			auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-			std::tm tm_buf;
-#ifdef _WIN32
-			localtime_s(&tm_buf, &now);
-#else
-			localtime_r(&now, &tm_buf);
-#endif
-			char timeStr[22] = { 0 };
-			std::strftime(timeStr, sizeof(timeStr), strFormat.c_str(), &tm_buf);
-			return std::string(timeStr);
+			if (!s) return nullptr;
+			std::lock_guard<std::mutex> lock(locationLock);
+			return locations_.emplace(s).first->c_str();
 		}
 
-		std::string logTypeStr(LogType lt)
+		int64_t nowNs() const
 		{
-			std::string back;
-			switch (lt)
+			return preciseTime_ ? TimeService::NowNs() : TimeService::CoarseNowNs();
+		}
+
+		// ring of the calling thread, registered on first use
+		LogThreadBuffer& LocalBuffer()
+		{
+			struct LocalHandle
 			{
-			case LogType::error:
+				std::shared_ptr<LogThreadBuffer> buffer;
+				std::atomic<uint64_t>* version{ nullptr };
+				~LocalHandle()
+				{
+					if (!buffer) return;
+					buffer->orphaned.store(true, std::memory_order_release);
+					version->fetch_add(1, std::memory_order_release);
+				}
+			};
+			thread_local LocalHandle handle;
+
+			if (!handle.buffer)
 			{
-				back = "ERROR";
-				break;
+				auto buffer = std::make_shared<LogThreadBuffer>();
+				{
+					std::lock_guard<std::mutex> lock(registryLock);
+					buffers_.push_back(buffer);
+				}
+				handle.version = &registryVersion_;
+				registryVersion_.fetch_add(1, std::memory_order_release);
+				handle.buffer = std::move(buffer);
 			}
-			case LogType::warning:
+			return *handle.buffer;
+		}
+
+		// seq_cst fence pairs with the one in WaitForRecords, either the sleeper sees the record or we see the sleeper
+		void WakeConsumer()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (sleeping_.load(std::memory_order_relaxed))
 			{
-				back = "WARNING";
-				break;
+				std::lock_guard<std::mutex> lock(wakeLock);
+				wakeCv.notify_one();
 			}
-			case LogType::userevent:
+		}
+
+		// false only if the logger is stopped, a full ring is handled by the overflow policy
+		bool AddLog_(LogRecord& rec)
+		{
+			if (closed_.load(std::memory_order_relaxed))
 			{
-				back = "USEREVENT";
-				break;
+				rec.Release();
+				return false;
 			}
-			case LogType::info:
-			default:
+
+			LogThreadBuffer& buffer = LocalBuffer();
+			if (!buffer.ring.push(rec))
 			{
-				back = "INFO";
-				break;
-			}
+				bool pushed = false;
+				if (overflowPolicy_.load(std::memory_order_relaxed) == LogOverflowPolicy::block
+					&& consumerId_.load(std::memory_order_relaxed) != std::this_thread::get_id())
+				{
+					for (int spin = 0; consuming_.load(std::memory_order_relaxed) && !closed_.load(std::memory_order_relaxed); spin++)
+					{
+						WakeConsumer();
+						if (spin < 64)
+							std::this_thread::yield();
+						else
+							std::this_thread::sleep_for(std::chrono::microseconds(50));
+						if (buffer.ring.push(rec))
+						{
+							pushed = true;
+							break;
+						}
+					}
+				}
+				if (!pushed)
+				{
+					buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+					rec.Release();
+					WakeConsumer();
+					return true;
+				}
 			}
-			return back;
+			WakeConsumer();
+			return true;
 		}
 
-		bool AddLog_(const std::string& log)
+		// text copied into the record payload, allocates only when longer than the payload
+		void LogText(const LogCallsite* callsite, std::string_view msg, LogType lt)
 		{
-			bool back = false;				
-			back = logQueue_.push(log);	
-			return back;
+			if (!callsite && !LogLevels::Instance().IsEnabled(lt)) return;
+			LogRecord rec;
+			rec.Reset(lt, nowNs());
+			rec.callsite = callsite;
+			rec.SetText(msg.data(), msg.size());
+			if (!AddLog_(rec))
+				std::cout << "Logger unavaliable " << std::endl;
+		}
 
+		// the text line of a record, same layout the producers used to build
+		void FormatRecord(const LogRecord& rec, std::string& out)
+		{
+			FormatLogLine(rec, logTimeCache_.Format(rec.timestamp), out);
 		}
 
-		bool HandleFile(const std::string& newpath = "")
+		// a line given as is, not formatted (session separator)
+		void WriteLine(std::string_view line)
 		{
-			//new file
-			if (currentFile_ != newpath)
+			LogRecord rec;
+			rec.Reset(LogType::info, nowNs());
+			rec.SetText(line.data(), line.size());
+			for (const auto& sink : sinks_)
 			{
-				CloseFile();
-				if (newpath.empty()) return false;
+				if (sink->Accepts(rec.type))
+					sink->Write(rec, line);
+			}
+			rec.Release();
+		}
 
-				try
+		void WriteRecord(const LogRecord& rec, std::string& strlog)
+		{
+			// the text line is built once, and only if a sink taking the record needs it
+			strlog.clear();
+			bool formatted = false;
+			for (const auto& sink : sinks_)
+			{
+				if (!sink->Accepts(rec.type)) continue;
+				if (!formatted && sink->NeedsText())
 				{
-					ofs.open(newpath.c_str(), std::ios::out | std::ios::app);
-					currentFile_ = newpath;
+					FormatRecord(rec, strlog);
+					formatted = true;
 				}
-				catch (std::ofstream::failure& e)
+				sink->Write(rec, strlog);
+			}
+		}
+
+		// flight recorder records not written yet, framed so they are not taken for live output
+		void DumpFlight(std::string& strlog)
+		{
+			flightRecs_.clear();
+			LogFlightRecorder::Instance().Collect(flightRecs_, true);
+			if (flightRecs_.empty()) return;
+			WriteLine("----- flight recorder -----");
+			for (const auto& rec : flightRecs_)
+				WriteRecord(rec, strlog);
+			WriteLine("----- flight recorder end -----");
+		}
+
+		// same call site / location, type and payload as the last record written, the time is not compared
+		bool IsRepeat(const LogRecord& rec) const
+		{
+			if (!hasLast_ || rec.type != lastRec_.type || rec.callsite != lastRec_.callsite || rec.file != lastRec_.file
+				|| rec.line != lastRec_.line || rec.size != lastRec_.size || rec.argCount != lastRec_.argCount
+				|| (rec.longText != nullptr) != lastHasLong_)
+				return false;
+			if (rec.longText)
+				return *rec.longText == lastLong_;
+			return std::memcmp(rec.payload, lastRec_.payload, rec.size) == 0;
+		}
+
+		void Remember(const LogRecord& rec)
+		{
+			std::memcpy(&lastRec_, &rec, sizeof(LogRecord));
+			lastRec_.longText = nullptr;
+			lastHasLong_ = rec.longText != nullptr;
+			if (lastHasLong_)
+				lastLong_.assign(*rec.longText);
+			hasLast_ = true;
+		}
+
+		void FlushRepeats(std::string& strlog)
+		{
+			if (repeats_ == 0) return;
+			char buf[64];
+			std::string_view head("last message repeated ");
+			std::memcpy(buf, head.data(), head.size());
+			auto res = std::to_chars(buf + head.size(), buf + 40, repeats_);
+			std::string_view tail(" times");
+			std::memcpy(res.ptr, tail.data(), tail.size());
+
+			LogRecord rec;
+			rec.Reset(lastRec_.type, nowNs());
+			rec.SetText(buf, static_cast<size_t>(res.ptr - buf) + tail.size());
+			WriteRecord(rec, strlog);
+			repeats_ = 0;
+		}
+
+		// "last message repeated" when due, "N messages suppressed" of the rate limit once a second
+		void ReportStorms(std::string& strlog, bool force)
+		{
+			int64_t now = TimeService::MonotonicNs();
+			if (repeats_ > 0 && (force || now - repeatStart_ >= LogDropReportNs))
+				FlushRepeats(strlog);
+
+			if (!LogRateLimiter::Instance().HasSuppressed()) return;
+			if (!force && now - lastRateReport_ < LogDropReportNs) return;
+			lastRateReport_ = now;
+			suppressed_.clear();
+			LogRateLimiter::Instance().TakeSuppressed(suppressed_);
+			for (const auto& item : suppressed_)
+			{
+				char buf[64];
+				auto res = std::to_chars(buf, buf + 24, item.second);
+				std::string_view tail(" messages suppressed by the rate limit");
+				std::memcpy(res.ptr, tail.data(), tail.size());
+
+				LogRecord rec;
+				rec.Reset(LogType::warning, nowNs());
+				rec.file = item.first.file;
+				rec.func = item.first.func;
+				rec.line = item.first.line;
+				rec.SetText(buf, static_cast<size_t>(res.ptr - buf) + tail.size());
+				WriteRecord(rec, strlog);
+			}
+		}
+
+		void HandleRecord(LogRecord& rec, std::string& strlog)
+		{
+			if (collapseRepeats_.load(std::memory_order_relaxed))
+			{
+				if (IsRepeat(rec))
 				{
-					std::string strerr(e.what());
-					std::cerr << "Exception opening logfile : " + strerr << std::endl;
-					return false;
+					if (repeats_++ == 0)
+						repeatStart_ = TimeService::MonotonicNs();
+					rec.Release();
+					return;
 				}
-				return true;
+				FlushRepeats(strlog);
+				Remember(rec);
 			}
 
+			if (rec.type == LogType::error && flightDumpOnError_.load(std::memory_order_relaxed)
+				&& LogFlightRecorder::Instance().IsEnabled())
+				DumpFlight(strlog);
+			WriteRecord(rec, strlog);
+			rec.Release();
+		}
 
-			if (!ofs.is_open())
+		// ns until a sink wants FlushIfDue again, -1 none
+		int64_t FlushSinksIfDue()
+		{
+			rotator_->Kick();
+			int64_t wait = -1;
+			for (const auto& sink : sinks_)
 			{
-				try
+				int64_t due = sink->FlushIfDue();
+				if (due >= 0 && (wait < 0 || due < wait)) wait = due;
+			}
+			return wait;
+		}
+
+		void OnStopFlag()
+		{
+			//std::cout << "Logger on stop flag" << std::endl;
+			closed_.store(true);
+			std::lock_guard<std::mutex> lock(wakeLock);
+			wakeCv.notify_all();
+		}
+
+		// consumer copy of the registry, drained rings of exited threads are removed
+		void RefreshBuffers(std::vector<std::shared_ptr<LogThreadBuffer>>& buffers, uint64_t& version)
+		{
+			uint64_t current = registryVersion_.load(std::memory_order_acquire);
+			if (current == version) return;
+
+			std::lock_guard<std::mutex> lock(registryLock);
+			for (auto it = buffers_.begin(); it != buffers_.end();)
+			{
+				if ((*it)->orphaned.load(std::memory_order_acquire) && (*it)->ring.empty())
 				{
-					ofs.open(logFile_.c_str(), std::ios::out | std::ios::app);
+					pendingDropped_ += (*it)->dropped.exchange(0, std::memory_order_relaxed);
+					it = buffers_.erase(it);
 				}
-				catch (std::ofstream::failure& e)
+				else
 				{
-					CloseFile();
-					std::string strerr(e.what());
-					std::cerr << "Exception opening logfile : " + strerr << std::endl;
-					return false;
+					++it;
 				}
-				return true;
 			}
-
-			return true;
+			buffers = buffers_;
+			version = current;
 		}
 
-		void CloseFile()
+		// handles up to max records, oldest timestamp first across the thread rings
+		size_t DrainBuffers(const std::vector<std::shared_ptr<LogThreadBuffer>>& buffers, std::string& strlog, size_t max)
 		{
-			ofs.flush();
-			ofs.close();
+			size_t count = 0;
+			while (count < max)
+			{
+				LogThreadBuffer* owner = nullptr;
+				LogRecord* oldest = nullptr;
+				for (const auto& buffer : buffers)
+				{
+					LogRecord* rec = buffer->ring.front();
+					if (rec && (!oldest || rec->timestamp < oldest->timestamp))
+					{
+						oldest = rec;
+						owner = buffer.get();
+					}
+				}
+				if (!oldest) break;
+
+				HandleRecord(*oldest, strlog);
+				owner->ring.pop_front();
+				count++;
+			}
+			return count;
 		}
 
-		void WriteLog(std::string log)
+		bool AnyPending(const std::vector<std::shared_ptr<LogThreadBuffer>>& buffers) const
 		{
-			if (!log.empty() && log.back() == '\n')
-				log.pop_back();
-
-			if (sinkConsole)
+			for (const auto& buffer : buffers)
 			{
-				std::cout << log << std::endl;
+				if (!buffer->ring.empty()) return true;
 			}
+			return false;
+		}
 
+		// collects drop counters, writes the countAndDrop line when due
+		void ReportDropped(const std::vector<std::shared_ptr<LogThreadBuffer>>& buffers, std::string& strlog, bool force)
+		{
+			uint64_t dropped = 0;
+			for (const auto& buffer : buffers)
+				dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+			if (dropped > 0)
+			{
+				droppedTotal_.fetch_add(dropped, std::memory_order_relaxed);
+				pendingDropped_ += dropped;
+			}
+			if (pendingDropped_ == 0) return;
 
-			if (sinkFile)
+			if (overflowPolicy_.load(std::memory_order_relaxed) != LogOverflowPolicy::countAndDrop)
 			{
-				logFile_.clear();
-				logFile_ = logPath_ + timeStr(logFileFormat_) + ".txt";
+				pendingDropped_ = 0;
+				return;
+			}
 
-				if (!HandleFile(logFile_)) return;
+			int64_t now = TimeService::MonotonicNs();
+			if (!force && now - lastDropReport_ < LogDropReportNs) return;
 
-				try
-				{
-					ofs << log << std::endl;
-				}
-				catch (const std::exception&)
-				{
-					ofs.close();
-					std::cout << "Cannot output log string" << std::endl;
-				}
+			char buf[64];
+			auto res = std::to_chars(buf, buf + sizeof(buf), pendingDropped_);
+			std::string_view tail(" messages dropped");
+			std::memcpy(res.ptr, tail.data(), tail.size());
 
-			}
+			LogRecord rec;
+			rec.Reset(LogType::warning, nowNs());
+			rec.SetText(buf, static_cast<size_t>(res.ptr - buf) + tail.size());
+			HandleRecord(rec, strlog);
+			pendingDropped_ = 0;
+			lastDropReport_ = now;
 		}
 
-		void OnStopFlag()
+		// sleeps until a producer wakes us, the file flush is due or the drop line is due
+		void WaitForRecords(const std::vector<std::shared_ptr<LogThreadBuffer>>& buffers)
 		{
-			//std::cout << "Logger on stop flag" << std::endl;
-			logQueue_.close();
+			int64_t wait = 1000000000;
+			int64_t due = FlushSinksIfDue();
+			if (due >= 0 && due < wait) wait = due;
+			if (pendingDropped_ > 0)
+			{
+				int64_t reportDue = LogDropReportNs - (TimeService::MonotonicNs() - lastDropReport_);
+				if (reportDue < wait) wait = reportDue > 0 ? reportDue : 0;
+			}
+			if (repeats_ > 0)
+			{
+				int64_t repeatDue = LogDropReportNs - (TimeService::MonotonicNs() - repeatStart_);
+				if (repeatDue < wait) wait = repeatDue > 0 ? repeatDue : 0;
+			}
+			if (LogRateLimiter::Instance().HasSuppressed())
+			{
+				int64_t rateDue = LogDropReportNs - (TimeService::MonotonicNs() - lastRateReport_);
+				if (rateDue < wait) wait = rateDue > 0 ? rateDue : 0;
+			}
+			if (wait <= 0) return;
+
+			std::unique_lock<std::mutex> lock(wakeLock);
+			sleeping_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!AnyPending(buffers) && !closed_.load() && registryVersion_.load(std::memory_order_relaxed) == lastVersion_
+				&& !flightDumpRequested_.load())
+				wakeCv.wait_for(lock, std::chrono::nanoseconds(wait));
+			sleeping_.store(false, std::memory_order_relaxed);
 		}
 
 		void ConsumeLogs()
 		{
-			WriteLog("=====================================================================");
+			consumerId_.store(std::this_thread::get_id());
+			WriteLine("=====================================================================");
 
+			std::vector<std::shared_ptr<LogThreadBuffer>> buffers;
 			std::string strlog;
-			while (logQueue_.wait_pop(strlog))
+			strlog.reserve(512);
+			while (!consumerTh_->GetStopFlag() && !closed_.load())
 			{
-				// decide whether there is a new item or time to stop
-				if (consumerTh_->GetStopFlag() || logQueue_.is_closed()) break;
+				RefreshBuffers(buffers, lastVersion_);
 
-				if (!strlog.empty())
+				// one batch, the sinks write or hand over once per batch
+				size_t count = DrainBuffers(buffers, strlog, MaxLogBatch);
+				ReportDropped(buffers, strlog, false);
+				ReportStorms(strlog, false);
+				if (flightDumpRequested_.exchange(false))
 				{
-					if (logHandler_)
-					{
-						logHandler_(strlog);
-					}
-					else
-					{
-						WriteLog(strlog);
-					}						
-					cbLog_.invoke(strlog);
+					DumpFlight(strlog);
+					count++;
+				}
+				if (count > 0)
+				{
+					for (const auto& sink : sinks_)
+						sink->EndBatch();
+					continue;
 				}
-				strlog.clear();
-
-				if (consumerTh_->GetStopFlag() || logQueue_.is_closed()) break;
 
+				WaitForRecords(buffers);
 			}
 
-
-				/*if (consumerTh_->GetStopFlag() && logQueue_.is_empty())
-					break;*/
-			
+			// lines logged before stop are still written
+			RefreshBuffers(buffers, lastVersion_);
+			DrainBuffers(buffers, strlog, SIZE_MAX);
+			ReportDropped(buffers, strlog, true);
+			ReportStorms(strlog, true);
+			hasLast_ = false;
+			for (const auto& sink : sinks_)
+				sink->Flush();
+			consumerId_.store(std::thread::id());
 		}
 
 		Logger()
 			:isStarted(false),
 			logPath_("."),
-			logQueue_(MaxLogQueueSize)
+			logTimeCache_(logTimeFormat_)
 		{
 		}
 
@@ -269,6 +639,7 @@ namespace NESES
 				return instance;
 			}
 
+			// a handler replaces the default console and file sinks, sinks added with AddSink are kept
 			void Init(				
 				std::function<void(std::string)> handler = nullptr, 
 				const std::string logpath = ".",
@@ -278,14 +649,51 @@ namespace NESES
 				const std::string defHandlerFileFormat =  "%Y-%m-%d"
 				)
 			{
+				if (isStarted) return;
 				logPath_ = logpath;
-				logHandler_ = handler;
 				sinkConsole = defHandlerSinkConsole;
 				sinkFile = defHandlerSinkFile;
 				logTimeFormat_ = defHandlerTimeFormat;
 				logFileFormat_ = defHandlerFileFormat;
-				consumerTh_ = App::Instance().NewWorker("logger");
-				consumerTh_->RegisterNotifierCB(std::bind(&Logger::OnStopFlag, this));
+				logTimeCache_.SetFormat(logTimeFormat_);
+				fileSink_->SetBinary(binaryFile_);
+				fileSink_->SetPath(logPath_, logFileFormat_, binaryFile_ ? ".nlog" : ".txt");
+				if (mmapSink_)
+					mmapSink_->SetPath(logPath_, logFileFormat_);
+				rotator_->SetPath(logPath_, logFileFormat_, binaryFile_ ? ".nlog" : ".txt");
+				preciseTime_ = logTimeCache_.HasFraction();
+
+				sinks_.clear();
+				if (handler)
+				{
+					sinks_.push_back(std::make_shared<LogHandlerSink>(handler));
+				}
+				else
+				{
+					if (sinkConsole)
+						sinks_.push_back(consoleSink_);
+					std::string reason;
+					if (sinkFile && mmapSink_ && !LogMmapSink::CanPreallocate(logPath_, reason))
+					{
+						std::cerr << "Mapped logfile cannot be preallocated at " << logPath_ << " (" << reason << "), using the plain logfile" << std::endl;
+						mmapSink_.reset();
+					}
+					if (sinkFile)
+						sinks_.push_back(mmapSink_ ? std::static_pointer_cast<LogSink>(mmapSink_) : fileSink_);
+				}
+				sinks_.insert(sinks_.end(), extraSinks_.begin(), extraSinks_.end());
+
+				// Init after Stop reuses the thread, the thread manager never gives a slot back
+				if (!consumerTh_)
+				{
+					consumerTh_ = App::Instance().NewWorker("logger");
+					if (!consumerTh_)
+					{
+						std::cerr << "Logger not started : no worker thread" << std::endl;
+						return;
+					}
+					consumerTh_->RegisterNotifierCB(std::bind(&Logger::OnStopFlag, this));
+				}
 				Start();
 			}
 
@@ -293,67 +701,308 @@ namespace NESES
 			{
 				if (!isStarted) return;
 				//consumerTh_->SetStopFlag(true);
+				consuming_.store(false);
 				consumerTh_->Stop();
 				isStarted = false;
-				CloseFile();
+				for (const auto& sink : sinks_)
+					sink->Stop();
+				rotator_->Stop();
 				std::cout << "Quiting Logger" << std::endl;
 			}
 
+			// file flush policy (bytes, interval, errors), set it before Init
+			void SetFlushPolicy(const LogFlushPolicy& policy)
+			{
+				fileSink_->SetPolicy(policy);
+				if (mmapSink_)
+					mmapSink_->SetPolicy(policy);
+			}
+
+			// memory mapped, preallocated log segments instead of write calls, set it before Init
+			void UseMappedFile(size_t segmentSize = 64 * 1024 * 1024)
+			{
+				if (isStarted || binaryFile_) return;
+				mmapSink_ = std::make_shared<LogMmapSink>(segmentSize);
+				mmapSink_->SetPolicy(fileSink_->GetPolicy());
+				mmapSink_->SetRotation(rotator_);
+			}
+
+			// binary (.nlog) log files instead of text, read them with NESESLOGDEC, set it before Init
+			// console and handler output stay text, the mapped file is not used with it
+			void UseBinaryFile(bool binary = true)
+			{
+				if (isStarted) return;
+				binaryFile_ = binary;
+				if (binaryFile_)
+					mmapSink_.reset();
+			}
+
+			// size / age rolling, gzip and retention of closed log files, set it before Init
+			void SetRotationPolicy(const LogRotationPolicy& policy)
+			{
+				if (isStarted) return;
+				rotator_->SetPolicy(policy);
+				fileSink_->SetRotation(rotator_);
+				if (mmapSink_)
+					mmapSink_->SetRotation(rotator_);
+			}
+
+			// extra output (LogRemoteSink, LogHandlerSink, own LogSink), add it before Init
+			void AddSink(std::shared_ptr<LogSink> sink)
+			{
+				if (isStarted || !sink) return;
+				extraSinks_.push_back(std::move(sink));
+			}
+
+			// sinks of the running logger, for their levels (SetLevel) and drop counters (Dropped)
+			const std::vector<std::shared_ptr<LogSink>>& GetSinks() const
+			{
+				return sinks_;
+			}
+
+			// records under the output level down to lt are kept per thread in memory (LogFlightRecorder),
+			// and written before the next error line when dumpOnError is set
+			void SetFlightRecorder(LogType lt, bool dumpOnError = true)
+			{
+				flightDumpOnError_.store(dumpOnError);
+				LogFlightRecorder::Instance().SetLevel(lt);
+			}
+
+			void DisableFlightRecorder()
+			{
+				LogFlightRecorder::Instance().Disable();
+			}
+
+			// writes the recorded records not written yet, on the logger thread
+			void DumpFlightRecorder()
+			{
+				flightDumpRequested_.store(true);
+				WakeConsumer();
+			}
+
+			// per call site token bucket, perSecond 0 turns it off (default), see LogRateLimiter
+			void SetRateLimit(double perSecond, uint32_t burst = 10)
+			{
+				LogRateLimiter::Instance().Set(perSecond, burst);
+			}
+
+			// records equal to the previous one (text, arguments, location, type) are counted, not written,
+			// "last message repeated N times" follows when a different record comes or once a second
+			void SetCollapseRepeats(bool collapse)
+			{
+				collapseRepeats_.store(collapse);
+			}
+
+			// runtime minimum level, lower levels are skipped before the message is built
+			void SetLevel(LogType lt)
+			{
+				LogLevels::Instance().SetLevel(lt);
+			}
+
+			// level of one module tag (NESES_LOG_TAG), overrides the global level
+			void SetLevel(const std::string& tag, LogType lt)
+			{
+				LogLevels::Instance().SetLevel(tag, lt);
+			}
+
+			void ClearLevel(const std::string& tag)
+			{
+				LogLevels::Instance().ClearLevel(tag);
+			}
+
+			// full producer ring behaviour, countAndDrop by default
+			void SetOverflowPolicy(LogOverflowPolicy policy)
+			{
+				overflowPolicy_.store(policy);
+			}
+
+			// records discarded by the overflow policy so far (counted by the logger thread)
+			uint64_t DroppedCount() const
+			{
+				return droppedTotal_.load(std::memory_order_relaxed);
+			}
+
 			void Start()
 			{
 				if (isStarted) return;
 				std::cout << "Starting Logger" << std::endl;
 				consumerTh_->Set(&Logger::ConsumeLogs, this);
 				consumerTh_->SetStopFlag(false);
+				closed_.store(false);
+				consuming_.store(true);
+				for (const auto& sink : sinks_)
+					sink->Start();
+				rotator_->Start();
 				consumerTh_->Start();
 				isStarted = true;
 			}
 
 
 			// logstream
-				// Stream class for building log messages
+				// Stream class for building log messages, formats into a reused thread_local buffer
+				// numbers with to_chars, other types through a thread_local std::ostringstream
 			class LogStream {
 			public:
-				LogStream(Logger& logger, LogType level) : logger_(logger), level_(level) {}
+				LogStream(Logger& logger, LogType level) : logger_(logger), level_(level) { Acquire(); }
+				LogStream(Logger& logger, const LogCallsite& callsite, LogType level) : logger_(logger), callsite_(&callsite), level_(level) { Acquire(); }
 				~LogStream()
 				{
 					flush();
+					Local().depth--;
 				}
 
-				// Overload << for various types
+				LogStream(const LogStream&) = delete;
+				LogStream& operator=(const LogStream&) = delete;
+
+				// Overload << for various types, output as std::ostream would print them
 				template <typename T>
 				LogStream& operator<<(const T& value)
 				{
-					stream_ << value;
+					using D = std::decay_t<T>;
+					if constexpr (std::is_same_v<D, bool>)
+						buf_->push_back(value ? '1' : '0');
+					else if constexpr (std::is_same_v<D, char> || std::is_same_v<D, signed char> || std::is_same_v<D, unsigned char>)
+						buf_->push_back(static_cast<char>(value));
+					else if constexpr (std::is_integral_v<D>)
+						AppendInteger(value);
+					else if constexpr (std::is_floating_point_v<D>)
+						AppendFloat(value);
+					else if constexpr (std::is_array_v<std::remove_reference_t<T>> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>)
+						Append(std::string_view(value));		// literals and char buffers, never null
+					else if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>)
+						Append(value ? std::string_view(value) : std::string_view("(null)"));
+					else if constexpr (std::is_convertible_v<const D&, std::string_view>)
+						Append(std::string_view(value));
+					else if constexpr (std::is_pointer_v<D> && !std::is_invocable_v<D, std::ostream&>)
+						AppendPointer(reinterpret_cast<uintptr_t>(value));
+					else
+						AppendStreamed(value);
 					return *this;
 				}
 
 				// Non-template overloads are preferred over template instantiations
-				// Handle manipulators (e.g., std::endl, '\n')
+				// Handle manipulators (e.g., std::endl, std::hex), others apply to the ostream fallback
 				LogStream& operator<<(std::ostream& (*manip)(std::ostream&))
 				{
-					stream_ << manip;
-					if (manip == static_cast<std::ostream & (*)(std::ostream&)>(std::endl) ||
-						manip == static_cast<std::ostream & (*)(std::ostream&)>(std::flush)) {
+					using Manip = std::ostream& (*)(std::ostream&);
+					if (manip == static_cast<Manip>(std::endl) || manip == static_cast<Manip>(std::flush))
+					{
 						flush();
+						return *this;
 					}
+					Local().fallback << manip;
+					return *this;
+				}
+
+				LogStream& operator<<(std::ios_base& (*manip)(std::ios_base&))
+				{
+					Local().fallback << manip;
+					if (manip == &std::hex) base_ = 16;
+					else if (manip == &std::oct) base_ = 8;
+					else if (manip == &std::dec) base_ = 10;
 					return *this;
 				}
 
 			private:
-				void flush()
+				static constexpr int maxDepth = 4;
+
+				// a message built while another one is (operator<< of a logged type logs) gets the next buffer
+				struct LocalBuffers
+				{
+					std::string bufs[maxDepth];
+					int depth{ 0 };
+					std::ostringstream fallback;
+					bool fallbackInUse{ false };
+				};
+
+				static LocalBuffers& Local()
+				{
+					thread_local LocalBuffers local;
+					return local;
+				}
+
+				void Acquire()
 				{
-					std::string message = stream_.str();
-					if (!message.empty())
+					LocalBuffers& local = Local();
+					buf_ = local.depth < maxDepth ? &local.bufs[local.depth] : &own_;
+					if (local.depth == 0)
 					{
-						logger_.log(message, level_);
+						// manipulators of the previous message do not carry over
+						local.fallback.flags(std::ios_base::dec | std::ios_base::skipws);
+						local.fallback.precision(6);
+						local.fallback.fill(' ');
 					}
-					stream_.str(""); // Clear stream
+					local.depth++;
+					buf_->clear();
+					if (buf_->capacity() < 256)
+						buf_->reserve(256);
+				}
+
+				void Append(std::string_view sv)
+				{
+					buf_->append(sv.data(), sv.size());
+				}
+
+				template <typename I>
+				void AppendInteger(I value)
+				{
+					char tmp[72];
+					std::to_chars_result res;
+					if (base_ == 10)
+						res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+					else
+						res = std::to_chars(tmp, tmp + sizeof(tmp), static_cast<std::make_unsigned_t<I>>(value), base_);
+					buf_->append(tmp, static_cast<size_t>(res.ptr - tmp));
+				}
+
+				// %g with precision 6, the std::ostream default
+				template <typename F>
+				void AppendFloat(F value)
+				{
+					char tmp[64];
+					auto res = std::to_chars(tmp, tmp + sizeof(tmp), value, std::chars_format::general, 6);
+					buf_->append(tmp, static_cast<size_t>(res.ptr - tmp));
+				}
+
+				void AppendPointer(uintptr_t value)
+				{
+					char tmp[24] = { '0', 'x' };
+					auto res = std::to_chars(tmp + 2, tmp + sizeof(tmp), static_cast<uint64_t>(value), 16);
+					buf_->append(tmp, static_cast<size_t>(res.ptr - tmp));
+				}
+
+				// types with their own operator<<
+				template <typename T>
+				void AppendStreamed(const T& value)
+				{
+					LocalBuffers& local = Local();
+					if (local.fallbackInUse)
+					{
+						std::ostringstream nested;
+						nested << value;
+						Append(nested.str());
+						return;
+					}
+					local.fallbackInUse = true;
+					local.fallback.str(std::string());
+					local.fallback << value;
+					Append(local.fallback.str());
+					local.fallbackInUse = false;
+				}
+
+				void flush()
+				{
+					if (!buf_->empty())
+						logger_.LogText(callsite_, *buf_, level_);
+					buf_->clear();
 				}
 
 				Logger& logger_;
+				const LogCallsite* callsite_{ nullptr };		// NESESLOG_STREAM, level already checked
 				LogType level_;
-				std::ostringstream stream_;
+				std::string* buf_{ nullptr };
+				std::string own_;		// deeper than maxDepth
+				int base_{ 10 };
 			};
 
 
@@ -361,28 +1010,58 @@ namespace NESES
 
 			void log(const std::string msg, LogType lt = LogType::info)
 			{
-				std::string strLog = timeStr(logTimeFormat_) + " : " + logTypeStr(lt) + " : " + msg;
-				if (!AddLog_(strLog))
+				if (!LogLevels::Instance().IsEnabled(lt)) return;
+				LogRecord rec;
+				rec.Reset(lt, nowNs());
+				rec.SetText(msg.data(), msg.size());
+				if (!AddLog_(rec))
 					std::cout << "Logger unavaliable " << std::endl;
 			}
 
+			// codefile and funcname are copied, any string will do; the macros are cheaper
 			void log(const char* codefile, const char* funcname, int linenumber, const std::string& msg, LogType lt = LogType::info)
 			{
-				std::string strLog = 
-					timeStr(logTimeFormat_) + " : " 
-					+ logTypeStr(lt) + " : "
-					+ codefile + " : " 
-					+ funcname + " : " 
-					+ std::to_string(linenumber) + " : " 
-					+ msg;
-				if (!AddLog_(strLog))
+				if (!LogLevels::Instance().IsEnabled(lt)) return;
+				const char* file = Location(codefile ? codefile : "");
+				const char* func = Location(funcname);
+				if (!LogRateLimiter::Instance().Allow(file, func, linenumber)) return;
+				LogRecord rec;
+				rec.Reset(lt, nowNs());
+				rec.file = file;
+				rec.func = func;
+				rec.line = linenumber;
+				rec.SetText(msg.data(), msg.size());
+				if (!AddLog_(rec))
 					std::cout << "Log unavaliable " << std::endl;
 			}
 
+			// text macros, the level is already checked against the callsite
+			void log(const LogCallsite& callsite, std::string_view msg, LogType lt)
+			{
+				LogText(&callsite, msg, lt);
+			}
+
+			// deferred formatting, use NESESLOGF / NESESDLOGF, the callsite must be static
+			template <typename... Args>
+			void logf(const LogCallsite& callsite, LogType lt, const Args&... args)
+			{
+				LogRecord rec;
+				rec.Reset(lt, nowNs());
+				rec.callsite = &callsite;
+				(rec.Append(args), ...);
+				if (!AddLog_(rec))
+					std::cout << "Logger unavaliable " << std::endl;
+			}
+
 			LogStream log(LogType logtype)
 			{
 				return LogStream(*this, logtype);
 			}
+
+			LogStream log(const LogCallsite& callsite, LogType logtype)
+			{
+				return LogStream(*this, callsite, logtype);
+			}
 	};
 
 }
\ No newline at end of file
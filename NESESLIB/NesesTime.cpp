@@ -1,4 +1,5 @@
 #include "NesesTime.hpp"
+#include "TimeService.hpp"
 #include "boost/date_time.hpp"
 
 struct NESES::NesesDateTime::NesesDateTimeImp
@@ -49,6 +50,10 @@ NESES::NesesDateTime::NesesDateTime()
 
 NESES::NesesDateTime::~NesesDateTime() = default;
 
+// move, the moved from object has no pimpl left, only destroy it or move assign to it
+NESES::NesesDateTime::NesesDateTime(NesesDateTime&& other) noexcept = default;
+NESES::NesesDateTime& NESES::NesesDateTime::operator=(NesesDateTime&& other) noexcept = default;
+
 
 // copy stor // deep copy 
 NESES::NesesDateTime::NesesDateTime(const NesesDateTime& other)
@@ -206,7 +211,9 @@ std::string NESES::NesesDateTime::Dump()
 void NESES::NesesDateTime::SetNow()
 {
 	//ldt = boost::local_time::local_microsec_clock::local_time();
-	pimpl->ldt = boost::local_time::local_microsec_clock::local_time(pimpl->tzUtc);
+	//pimpl->ldt = boost::local_time::local_microsec_clock::local_time(pimpl->tzUtc);
+	static const boost::posix_time::ptime unixEpoch(boost::gregorian::date(1970, 1, 1));
+	pimpl->ldt = boost::local_time::local_date_time(unixEpoch + boost::posix_time::microseconds(TimeService::NowNs() / 1000), pimpl->tzUtc);
 }
 
 tm NESES::NesesDateTime::GetTm(bool local)
@@ -19,9 +19,9 @@ namespace NESES
 		NesesDateTime(const std::string& str);								// paramed ctor
 		~NesesDateTime();													// dtor
 		NesesDateTime(const NesesDateTime& other);							// copy ctor
-		NesesDateTime(NesesDateTime&& other) noexcept = default;			// move ctor
+		NesesDateTime(NesesDateTime&& other) noexcept;						// move ctor, defined where NesesDateTimeImp is complete
 		NesesDateTime& operator=(const NesesDateTime& other);				// copy assign
-		NesesDateTime& operator=(NesesDateTime&& other) noexcept = default; // move assign
+		NesesDateTime& operator=(NesesDateTime&& other) noexcept;			// move assign
 		bool operator >(const NesesDateTime& other);
 		bool operator < (const NesesDateTime& other);
 		std::string ToString(const std::string& format = "%Y-%m-%d %H:%M:%S", bool localtime = true) const;
@@ -1,5 +1,6 @@
 #pragma once
 #include <atomic>
+#include <array>
 #include <optional>
 
 
@@ -61,6 +62,24 @@ public:
         return true;
     }
 
+    // consumer only: the oldest element in place, nullptr if empty. valid until pop_front
+    T* front()
+    {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &buffer_[tail];
+    }
+
+    // consumer only: releases the slot returned by front
+    void pop_front()
+    {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        tail_.store(increment(tail), std::memory_order_release);
+    }
+
     std::optional<T> pop() {  // modififer of tail
         auto tail = tail_.load(std::memory_order_relaxed);
         if (tail == head_.load(std::memory_order_acquire))
@@ -91,9 +110,10 @@ private:
         return (i + 1) % BufferSize;
     }
 
-    std::array<T, BufferSize> buffer_;
-    std::atomic<int> head_;
-    std::atomic<int> tail_;
+    // producer and consumer indices on their own cache lines
+    alignas(64) std::atomic<int> head_;
+    alignas(64) std::atomic<int> tail_;
+    alignas(64) std::array<T, BufferSize> buffer_;
 };
 
 }
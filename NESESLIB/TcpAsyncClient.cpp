@@ -1,10 +1,12 @@
 #include "TcpAsyncClient.hpp"
 #include "boost/asio.hpp"
+#include "TcpReactorImp.hpp"
 
 
 struct NESES::TcpAsyncClient::TASCImp
 {
-	boost::asio::io_context ioc;
+	std::unique_ptr<boost::asio::io_context> ownIoc;	// standalone mode only
+	boost::asio::io_context& ioc;
 	boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard_;
 	boost::asio::ip::tcp::endpoint endpoint;
 	boost::asio::ip::tcp::socket socket_;
@@ -14,22 +16,94 @@ struct NESES::TcpAsyncClient::TASCImp
 	boost::asio::strand<boost::asio::io_context::executor_type> strand_;
 	boost::asio::streambuf recvBuf;
 
+	// handlers still queued on a shared reactor; Stop waits for them before the client can go away
+	std::atomic<int> pendingOps{ 0 };
+	std::mutex pendingLock;
+	std::condition_variable pendingCv;
+
 	TASCImp(const TASCImp&) = delete;
 	TASCImp& operator=(const TASCImp&) = delete;
 
 	//todo move ctor and assignment?
 
 	TASCImp()
-		:socket_(ioc), 
-		strand_(boost::asio::make_strand(ioc)),
+		:TASCImp(std::make_unique<boost::asio::io_context>(1))
+	{
+
+	}
+
+	TASCImp(boost::asio::io_context& sharedioc)
+		:ioc(sharedioc),
+		work_guard_(boost::asio::make_work_guard(ioc)),
+		socket_(ioc),
+		connTimer(ioc),
 		writeTimer(ioc),
+		hbTimer(ioc),
+		strand_(boost::asio::make_strand(ioc))
+	{
+
+	}
+
+	// wrap a completion handler so it is counted in pendingOps until it has run
+	template <typename Handler>
+	auto track(Handler&& handler)
+	{
+		pendingOps++;
+		return [this, h = std::forward<Handler>(handler)](auto&&... args) mutable
+			{
+				// counted down even when h throws, the reactor survives a throwing handler
+				struct Done
+				{
+					TASCImp* imp;
+					~Done()
+					{
+						// under the lock, a waiter must not see 0 and free the client before notify is done
+						std::lock_guard<std::mutex> lock(imp->pendingLock);
+						if (--imp->pendingOps == 0)
+							imp->pendingCv.notify_all();
+					}
+				} done{ this };
+				h(std::forward<decltype(args)>(args)...);
+			};
+	}
+
+	// false on timeout or once the io_context is stopped, queued handlers do not run then
+	bool waitPending(std::chrono::seconds timeout)
+	{
+		auto until = std::chrono::steady_clock::now() + timeout;
+		std::unique_lock<std::mutex> lock(pendingLock);
+		while (pendingOps.load() > 0)
+		{
+			if (ioc.stopped() || std::chrono::steady_clock::now() >= until)
+				return false;
+			pendingCv.wait_for(lock, std::chrono::milliseconds(100));
+		}
+		return true;
+	}
+
+	// on the strand: ends the operations still queued, they complete with operation_aborted
+	void cancelAll()
+	{
+		boost::system::error_code ec;
+		writeTimer.cancel();
+		connTimer.cancel();
+		hbTimer.cancel();
+		socket_.cancel(ec);
+	}
+
+private:
+	TASCImp(std::unique_ptr<boost::asio::io_context> ownioc)
+		:ownIoc(std::move(ownioc)),
+		ioc(*ownIoc),
+		work_guard_(boost::asio::make_work_guard(ioc)),
+		socket_(ioc),
 		connTimer(ioc),
+		writeTimer(ioc),
 		hbTimer(ioc),
-		work_guard_(boost::asio::make_work_guard(ioc))
+		strand_(boost::asio::make_strand(ioc))
 	{
 
 	}
-	
 };
 
 void NESES::TcpAsyncClient::do_read()
@@ -59,8 +133,14 @@ void NESES::TcpAsyncClient::do_read()
 		readDelim_,
 		boost::asio::bind_executor(
 			pimpl->strand_,
-			[this](boost::system::error_code ec, std::size_t length)
+			pimpl->track([this](boost::system::error_code ec, std::size_t length)
 			{
+				if (stopFlag.load())
+				{
+					// aborted by Stop, not a connection error
+					isDone = true;
+					return;
+				}
 				if (ec)
 				{
 					cbError.invoke("async read error:" + ec.message());
@@ -95,7 +175,7 @@ void NESES::TcpAsyncClient::do_read()
 					}
 					do_read();
 				}
-			}));
+			})));
 }
 
 void NESES::TcpAsyncClient::sendHeartBeat()
@@ -104,13 +184,13 @@ void NESES::TcpAsyncClient::sendHeartBeat()
 		return;
 
 	std::string strHb = hbCommand_;
-	boost::asio::post(pimpl->strand_, [this, strHb]()
+	boost::asio::post(pimpl->strand_, pimpl->track([this, strHb]()
 		{ boost::asio::async_write(
 			pimpl->socket_,
 			boost::asio::buffer(strHb.c_str(), strHb.length()),
 			boost::asio::bind_executor(
 				pimpl->strand_,
-				[this](boost::system::error_code ec, std::size_t bytes_transferred)
+				pimpl->track([this](boost::system::error_code ec, std::size_t bytes_transferred)
 				{
 					if (ec)
 					{
@@ -122,7 +202,7 @@ void NESES::TcpAsyncClient::sendHeartBeat()
 						if (logHeartbeat)
 							cbInfo.invoke("Heartbeat sent");
 					}
-				})); });
+				}))); }));
 }
 
 void NESES::TcpAsyncClient::HeartBeat()
@@ -132,7 +212,7 @@ void NESES::TcpAsyncClient::HeartBeat()
 	pimpl->hbTimer.expires_after(std::chrono::seconds(1));
 	pimpl->hbTimer.async_wait(boost::asio::bind_executor(
 		pimpl->strand_,
-		[this](const boost::system::error_code& ec)
+		pimpl->track([this](const boost::system::error_code& ec)
 		{
 			if (hbStopFlag.load())
 				return;
@@ -145,7 +225,7 @@ void NESES::TcpAsyncClient::HeartBeat()
 
 			sendHeartBeat();
 			HeartBeat(); // reschedule next beat
-		}));
+		})));
 }
 
 NESES::TcpAsyncClient::TcpAsyncClient(int conntimeoutsecs, int writetimeoutsecs, int readtimeoutsecs)
@@ -154,17 +234,45 @@ NESES::TcpAsyncClient::TcpAsyncClient(int conntimeoutsecs, int writetimeoutsecs,
 	isStarted(false),
 	isConnected(false),
 	logHeartbeat(true),
+	connTimeoutSecs(conntimeoutsecs),
+	writeTimeoutSecs(writetimeoutsecs),
+	readTimeoutSecs(readtimeoutsecs),
 	stopFlag(false),
-	hbStopFlag(false),
+	hbStopFlag(false)
+{
+}
+
+NESES::TcpAsyncClient::TcpAsyncClient(TcpReactor& reactor, int conntimeoutsecs, int writetimeoutsecs, int readtimeoutsecs)
+	: pimpl(std::make_unique<TASCImp>(reactor.pimpl->ioc)),
+	reactor_(&reactor),
+	IsEndPointOk(false),
+	isStarted(false),
+	isConnected(false),
+	logHeartbeat(true),
 	connTimeoutSecs(conntimeoutsecs),
 	writeTimeoutSecs(writetimeoutsecs),
-	readTimeoutSecs(readtimeoutsecs)
+	readTimeoutSecs(readtimeoutsecs),
+	stopFlag(false),
+	hbStopFlag(false)
 {
+	reactor_->Register();
 }
 
 NESES::TcpAsyncClient::~TcpAsyncClient()
 {
 	DisConnect();
+	if (reactor_)
+	{
+		// a Connect without Start may still have handlers queued on the shared reactor
+		if (!pimpl->strand_.running_in_this_thread())
+		{
+			if (pimpl->pendingOps.load() > 0)
+				boost::asio::post(pimpl->strand_, pimpl->track([this]() { pimpl->cancelAll(); }));
+			if (!pimpl->waitPending(std::chrono::seconds(connTimeoutSecs + readTimeoutSecs + writeTimeoutSecs + 1)))
+				cbError.invoke("Pending handlers not awaited, reactor stopped or timeout");
+		}
+		reactor_->Unregister();
+	}
 }
 
 void NESES::TcpAsyncClient::WaitSeconds(int seconds)
@@ -202,31 +310,33 @@ void NESES::TcpAsyncClient::Connect(BackObject& back)
 	pimpl->connTimer.cancel();
 	pimpl->connTimer.expires_after(std::chrono::seconds(connTimeoutSecs));
 	pimpl->connTimer.async_wait(boost::asio::bind_executor(pimpl->strand_,
-		[this](const boost::system::error_code& err)
+		pimpl->track([this](const boost::system::error_code& err)
 		{
 			if (!err && !isConnected)
 			{
 				cbError.invoke("socket connect timeout! " + err.message());
-				pimpl->socket_.cancel();
+				boost::system::error_code ignored;
+				pimpl->socket_.cancel(ignored);		// may be closed by DisConnect already
 			}
-		}));
+		})));
 
 	pimpl->socket_.async_connect(pimpl->endpoint, boost::asio::bind_executor(
 		pimpl->strand_,
-		[this](const boost::system::error_code ec)
+		pimpl->track([this](const boost::system::error_code ec)
 		{
 			pimpl->connTimer.cancel();
 			if (ec)
 			{
 				cbError.invoke("socket connect failed! " + ec.message());
-				pimpl->socket_.cancel();
+				boost::system::error_code ignored;
+				pimpl->socket_.cancel(ignored);
 			}
 			else
 			{
 				isConnected = true;
 				cbConnected.invoke(true);
 			}
-		}));
+		})));
 }
 
 void NESES::TcpAsyncClient::Connect2(BackObject& back)
@@ -342,19 +452,19 @@ void NESES::TcpAsyncClient::AsyncWrite(const std::string& strRequest, size_t& se
 
 	boost::asio::post(
 		pimpl->strand_,
-		[this, strRequest]()
+		pimpl->track([this, strRequest]()
 		{
 			boost::asio::async_write(
 				pimpl->socket_,
 				boost::asio::buffer(strRequest.c_str(), strRequest.length()),
 				boost::asio::bind_executor(
 					pimpl->strand_,
-					[this](boost::system::error_code ec, std::size_t length)
+					pimpl->track([this](boost::system::error_code ec, std::size_t length)
 					{
 						if (ec)
 							cbError.invoke("Write operation failed: " + ec.message());
-					}));
-		});
+					})));
+		}));
 }
 
 void NESES::TcpAsyncClient::Start()
@@ -364,17 +474,29 @@ void NESES::TcpAsyncClient::Start()
 	stopFlag = false;
 	isDone = false;
 
-	service_thread = std::thread(
-		[this]()
-		{
-			cbInfo.invoke("Starting ioc thread");
-			auto rt = pimpl->ioc.run();
-			cbInfo.invoke("Exiting ioc thread");
-		});
+	if (reactor_)
+	{
+		reactor_->Start();
+	}
+	else
+	{
+		service_thread = std::thread(
+			[this]()
+			{
+				cbInfo.invoke("Starting ioc thread");
+				auto rt = pimpl->ioc.run();
+				cbInfo.invoke("Exiting ioc thread");
+			});
+	}
 	isStarted = true;
 	// std::this_thread::sleep_for(std::chrono::seconds(3));
-	do_read();
-	HeartBeat();
+
+	// start the loops on the strand, the reactor may run handlers on several threads
+	boost::asio::post(pimpl->strand_, pimpl->track([this]()
+		{
+			do_read();
+			HeartBeat();
+		}));
 }
 void NESES::TcpAsyncClient::Stop()
 {
@@ -390,6 +512,31 @@ void NESES::TcpAsyncClient::Stop()
 	//	socket.cancel(ignored_ec);		// Cancels all pending async ops (read/write)
 	// will trigger all pending async_read, async_write, etc. with boost::asio::error::operation_aborted.
 
+	if (reactor_)
+	{
+		// shared io_context keeps running: cancel our operations on the strand and
+		// wait until every handler referring to this client has run
+		boost::asio::post(pimpl->strand_, pimpl->track([this]()
+			{
+				boost::system::error_code ec;
+				pimpl->writeTimer.cancel();
+				pimpl->connTimer.cancel();
+				pimpl->hbTimer.cancel();
+				pimpl->socket_.cancel(ec);
+				pimpl->socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+			}));
+		pimpl->work_guard_.reset();
+
+		if (pimpl->strand_.running_in_this_thread())
+			cbError.invoke("Stop called from a client handler, pending handlers not awaited");
+		else if (!pimpl->waitPending(std::chrono::seconds(connTimeoutSecs + readTimeoutSecs + writeTimeoutSecs + 1)))
+			cbError.invoke("Pending handlers not awaited, reactor stopped or timeout");
+
+		isStarted = false;
+		cbInfo.invoke("client detached from reactor");
+		return;
+	}
+
 	pimpl->writeTimer.cancel(); // Unblocks async_wait() if it's pending
 	pimpl->connTimer.cancel();
 	pimpl->hbTimer.cancel();
@@ -8,6 +8,7 @@
 #include "TcpContext.hpp"
 #include "BackObject.hpp"
 #include "CallBack.hpp"
+#include "TcpReactor.hpp"
 #include "Exporter.h"
 
 namespace NESES
@@ -18,6 +19,7 @@ namespace NESES
 	private:
 		struct TASCImp;
 		std::unique_ptr<TASCImp> pimpl;
+		TcpReactor* reactor_{ nullptr };		// shared reactor, null when the client runs its own io_context
 
 		std::string readDelim_;
 		std::string hbCommand_;
@@ -50,6 +52,7 @@ namespace NESES
 		TcpAsyncClient& operator=(const TcpAsyncClient&) = delete;
 
 		TcpAsyncClient(int conntimeoutsecs = 3, int writetimeoutsecs = 3, int readtimeoutsecs = 3);
+		TcpAsyncClient(TcpReactor& reactor, int conntimeoutsecs = 3, int writetimeoutsecs = 3, int readtimeoutsecs = 3);
 		~TcpAsyncClient();
 
 		void WaitSeconds(int seconds);
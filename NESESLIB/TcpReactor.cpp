@@ -0,0 +1,111 @@
+#include <iostream>
+#include "TcpReactor.hpp"
+#include "TcpReactorImp.hpp"
+
+NESES::TcpReactor::TcpReactor(size_t threadcount)
+	: threadCount_(threadcount == 0 ? std::thread::hardware_concurrency() : threadcount)
+{
+	if (threadCount_ == 0) threadCount_ = 1;
+	pimpl = std::make_unique<TRImp>(static_cast<int>(threadCount_));
+	threads_.reserve(threadCount_);
+}
+
+NESES::TcpReactor::~TcpReactor()
+{
+	std::lock_guard<std::mutex> lock(reactorLock);
+	if (clientCount.load() > 0)
+		std::cerr << "TcpReactor destroyed with " << clientCount.load() << " registered clients" << std::endl;
+	StopThreads();
+}
+
+void NESES::TcpReactor::RunLoop()
+{
+	while (true)
+	{
+		try
+		{
+			pimpl->ioc.run();
+			break;
+		}
+		catch (const std::exception& ex)
+		{
+			// a throwing handler must not take the whole reactor down
+			std::cerr << "TcpReactor handler error: " << ex.what() << std::endl;
+		}
+		catch (...)
+		{
+			std::cerr << "TcpReactor unknown handler error!" << std::endl;
+		}
+	}
+}
+
+void NESES::TcpReactor::Register()
+{
+	clientCount++;
+}
+
+void NESES::TcpReactor::Unregister()
+{
+	clientCount--;
+}
+
+void NESES::TcpReactor::Start()
+{
+	std::lock_guard<std::mutex> lock(reactorLock);
+	if (isStarted.load())
+		return;
+
+	if (pimpl->ioc.stopped())
+		pimpl->ioc.restart();
+	pimpl->work_guard_ = std::make_unique<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>(
+		boost::asio::make_work_guard(pimpl->ioc));
+
+	for (size_t i = 0; i < threadCount_; i++)
+	{
+		threads_.emplace_back(&TcpReactor::RunLoop, this);
+	}
+	isStarted.store(true);
+}
+
+void NESES::TcpReactor::Stop()
+{
+	std::lock_guard<std::mutex> lock(reactorLock);
+	// handlers of a registered client would never run, the client would wait for them for nothing
+	if (clientCount.load() > 0)
+	{
+		std::cerr << "TcpReactor not stopped, " << clientCount.load() << " registered clients" << std::endl;
+		return;
+	}
+	StopThreads();
+}
+
+void NESES::TcpReactor::StopThreads()
+{
+	if (!isStarted.load())
+		return;
+
+	pimpl->work_guard_.reset();
+	pimpl->ioc.stop();
+	for (std::thread& th : threads_)
+	{
+		if (th.joinable())
+			th.join();
+	}
+	threads_.clear();
+	isStarted.store(false);
+}
+
+bool NESES::TcpReactor::IsStarted() const
+{
+	return isStarted.load();
+}
+
+size_t NESES::TcpReactor::GetThreadCount() const
+{
+	return threadCount_;
+}
+
+size_t NESES::TcpReactor::GetClientCount() const
+{
+	return clientCount.load();
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "boost/asio.hpp"
+#include "TcpReactor.hpp"
+
+// private to the library: shared between TcpReactor.cpp and TcpAsyncClient.cpp
+
+struct NESES::TcpReactor::TRImp
+{
+	boost::asio::io_context ioc;
+	std::unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_guard_;
+
+	TRImp(const TRImp&) = delete;
+	TRImp& operator=(const TRImp&) = delete;
+
+	TRImp(int concurrencyhint)
+		:ioc(concurrencyhint)
+	{
+
+	}
+};
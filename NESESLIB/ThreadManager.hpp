@@ -42,7 +42,7 @@ namespace NESES
     private:
         std::mutex tm_mtx;
         std::vector<std::shared_ptr<T>> workers;
-       const size_t MaxWorkerCount{ 4 };
+        size_t MaxWorkerCount{ 4 };
 
     public:
         ThreadManager(const size_t maxworkercount)
@@ -84,6 +84,13 @@ namespace NESES
             }
         }
 
+        // raising or lowering the cap does not touch the running workers
+        void SetMaxWorkerCount(const size_t maxworkercount)
+        {
+            std::lock_guard<std::mutex> lock(tm_mtx);
+            MaxWorkerCount = maxworkercount;
+        }
+
         std::size_t Count()  
         {
             std::lock_guard<std::mutex> lock(tm_mtx);
@@ -0,0 +1,220 @@
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <time.h>
+#include "TimeService.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NESES_HAS_TSC 1
+#endif
+
+namespace
+{
+	constexpr int64_t calibrationNs = 50000000;		// steady clock span the TSC rate is measured over
+	constexpr int64_t localCacheSpan = 900;			// utc offset reuse window, dst switches on quarter hours
+
+	int64_t SteadyNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+#ifdef NESES_HAS_TSC
+	uint64_t ReadTsc()
+	{
+		return __rdtsc();
+	}
+
+	// cpuid 0x80000007 edx bit 8, TSC runs at a constant rate in all power states
+	bool HasInvariantTsc()
+	{
+#ifdef _WIN32
+		int regs[4] = { 0 };
+		__cpuid(regs, 0x80000000);
+		if (static_cast<unsigned>(regs[0]) < 0x80000007u) return false;
+		__cpuid(regs, 0x80000007);
+		return (regs[3] & (1 << 8)) != 0;
+#else
+		unsigned a = 0, b = 0, c = 0, d = 0;
+		if (__get_cpuid_max(0x80000000u, nullptr) < 0x80000007u) return false;
+		__cpuid(0x80000007u, a, b, c, d);
+		return (d & (1u << 8)) != 0;
+#endif
+	}
+#endif
+
+	// TSC to ns mapping, measured once against steady_clock after calibrationNs
+	struct TscClock
+	{
+		std::atomic<int> state{ 0 };	// 0 measuring, 1 ready, -1 unusable
+		std::mutex calibrateLock;
+		uint64_t tsc0{ 0 };
+		int64_t steady0{ 0 };
+		uint64_t tscBase{ 0 };
+		int64_t nsBase{ 0 };
+		double nsPerTick{ 0.0 };
+
+		TscClock()
+		{
+#ifdef NESES_HAS_TSC
+			if (!HasInvariantTsc())
+			{
+				state = -1;
+				return;
+			}
+			steady0 = SteadyNs();
+			tsc0 = ReadTsc();
+#else
+			state = -1;
+#endif
+		}
+
+		int64_t Now()
+		{
+			int st = state.load(std::memory_order_acquire);
+#ifdef NESES_HAS_TSC
+			if (st == 1)
+				return nsBase + static_cast<int64_t>(static_cast<double>(ReadTsc() - tscBase) * nsPerTick);
+#endif
+			int64_t steady = SteadyNs();
+#ifdef NESES_HAS_TSC
+			if (st == 0 && steady - steady0 >= calibrationNs)
+			{
+				std::unique_lock<std::mutex> lock(calibrateLock, std::try_to_lock);
+				if (lock.owns_lock() && state.load(std::memory_order_relaxed) == 0)
+				{
+					uint64_t tsc = ReadTsc();
+					steady = SteadyNs();
+					if (tsc > tsc0 && steady > steady0)
+					{
+						nsPerTick = static_cast<double>(steady - steady0) / static_cast<double>(tsc - tsc0);
+						tscBase = tsc;
+						nsBase = steady;
+						state.store(1, std::memory_order_release);
+					}
+					else
+					{
+						state.store(-1, std::memory_order_release);
+					}
+				}
+			}
+#endif
+			return steady;
+		}
+	};
+
+	TscClock& GetTscClock()
+	{
+		static TscClock clock;
+		return clock;
+	}
+
+	// inverse of DaysFromCivil
+	void CivilFromDays(int64_t z, int& y, int& m, int& d)
+	{
+		z += 719468;
+		const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+		const int64_t doe = z - era * 146097;
+		const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		const int64_t mp = (5 * doy + 2) / 153;
+		d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+		m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+		y = static_cast<int>(yoe + era * 400 + (m <= 2 ? 1 : 0));
+	}
+}
+
+int64_t NESES::TimeService::NowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int64_t NESES::TimeService::CoarseNowNs()
+{
+#if defined(_WIN32)
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	uint64_t ticks = (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	return (static_cast<int64_t>(ticks) - 116444736000000000LL) * 100;		// 100ns since 1601 to ns since 1970
+#elif defined(CLOCK_REALTIME_COARSE)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0)
+		return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+	return NowNs();
+#else
+	return NowNs();
+#endif
+}
+
+int64_t NESES::TimeService::MonotonicNs()
+{
+	return GetTscClock().Now();
+}
+
+bool NESES::TimeService::IsTscClock()
+{
+	return GetTscClock().state.load(std::memory_order_acquire) == 1;
+}
+
+int64_t NESES::TimeService::DaysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+	y -= m <= 2 ? 1 : 0;
+	const int64_t era = (y >= 0 ? y : y - 399) / 400;
+	const int64_t yoe = y - era * 400;
+	const int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+void NESES::TimeService::LocalTime(std::time_t t, std::tm& out)
+{
+	thread_local int64_t cachedSpan = INT64_MIN;
+	thread_local int64_t cachedOffset = 0;
+	thread_local std::tm cachedTm{};		// keeps isdst and the platform zone fields (tm_zone, tm_gmtoff)
+
+	int64_t tt = static_cast<int64_t>(t);
+	int64_t span = tt >= 0 ? tt / localCacheSpan : (tt - localCacheSpan + 1) / localCacheSpan;
+	if (span != cachedSpan)
+	{
+#ifdef _WIN32
+		localtime_s(&out, &t);
+#else
+		localtime_r(&t, &out);
+#endif
+		int64_t local = DaysFromCivil(out.tm_year + 1900, out.tm_mon + 1, out.tm_mday) * 86400
+			+ out.tm_hour * 3600 + out.tm_min * 60 + out.tm_sec;
+		cachedOffset = local - tt;
+		cachedTm = out;
+		cachedSpan = span;
+		return;
+	}
+
+	int64_t local = tt + cachedOffset;
+	int64_t days = local >= 0 ? local / 86400 : (local - 86399) / 86400;
+	int64_t secs = local - days * 86400;
+	int y, m, d;
+	CivilFromDays(days, y, m, d);
+
+	out = cachedTm;
+	out.tm_year = y - 1900;
+	out.tm_mon = m - 1;
+	out.tm_mday = d;
+	out.tm_hour = static_cast<int>(secs / 3600);
+	out.tm_min = static_cast<int>((secs % 3600) / 60);
+	out.tm_sec = static_cast<int>(secs % 60);
+	out.tm_wday = static_cast<int>(((days % 7) + 11) % 7);		// 1970-01-01 was a thursday
+	out.tm_yday = static_cast<int>(days - DaysFromCivil(y, 1, 1));
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <ctime>
+#include <cstdint>
+#include "Exporter.h"
+
+/*
+Process wide clocks for hot paths (log lines, directory scans, timestamps of events).
+
+CoarseNowNs  : wall clock at kernel tick resolution (1-4 ms linux, ~15 ms windows), no syscall
+NowNs        : precise wall clock
+MonotonicNs  : invariant TSC scaled to ns when the cpu has one, steady_clock otherwise
+LocalTime    : localtime with the utc offset cached per quarter hour and thread
+*/
+
+namespace NESES
+{
+	class NESESAPI TimeService
+	{
+	public:
+		static int64_t NowNs();
+		static int64_t CoarseNowNs();
+		static int64_t MonotonicNs();
+		static bool IsTscClock();											// true once MonotonicNs runs on the calibrated TSC
+		static void LocalTime(std::time_t t, std::tm& out);
+		static int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d);	// days since 1970-01-01
+	};
+
+	/*
+	strftime with the formatted text cached per second, %3f / %6f (one per format) are patched
+	with milli / micro seconds. Not thread safe, keep one per thread (the logger thread owns its own).
+		CachedTimeFormat tf("[%Y-%m-%d %H:%M:%S.%3f]");
+		out.append(tf.Format(TimeService::NowNs()));
+	*/
+	class CachedTimeFormat
+	{
+	private:
+		static constexpr size_t bufSize = 128;
+
+		std::string before_;			// strftime part before the fraction field
+		std::string after_;				// strftime part after the fraction field
+		int fracDigits_{ 0 };
+		int64_t cachedSec_{ INT64_MIN };
+		size_t fracPos_{ 0 };
+		size_t len_{ 0 };
+		char buf_[bufSize]{};
+
+		size_t Strftime(const std::string& fmt, const std::tm& tmv, char* out, size_t cap)
+		{
+			if (fmt.empty() || cap == 0) return 0;
+			return std::strftime(out, cap, fmt.c_str(), &tmv);
+		}
+
+	public:
+		CachedTimeFormat() = default;
+		explicit CachedTimeFormat(const std::string& format) { SetFormat(format); }
+
+		void SetFormat(const std::string& format)
+		{
+			before_ = format;
+			after_.clear();
+			fracDigits_ = 0;
+			cachedSec_ = INT64_MIN;
+			for (size_t i = 0; i + 1 < format.size(); i++)
+			{
+				if (format[i] != '%') continue;
+				if (format[i + 1] == '%') { i++; continue; }
+				if (i + 2 < format.size() && (format[i + 1] == '3' || format[i + 1] == '6') && format[i + 2] == 'f')
+				{
+					fracDigits_ = format[i + 1] - '0';
+					before_ = format.substr(0, i);
+					after_ = format.substr(i + 3);
+					break;
+				}
+			}
+		}
+
+		bool HasFraction() const { return fracDigits_ > 0; }
+
+		// true if ts falls into another second than the last Format call
+		bool IsStale(int64_t tsNs) const
+		{
+			int64_t sec = tsNs >= 0 ? tsNs / 1000000000 : (tsNs - 999999999) / 1000000000;
+			return sec != cachedSec_;
+		}
+
+		// view into an internal buffer, valid until the next call
+		std::string_view Format(int64_t tsNs)
+		{
+			int64_t sec = tsNs >= 0 ? tsNs / 1000000000 : (tsNs - 999999999) / 1000000000;
+			if (sec != cachedSec_)
+			{
+				std::tm tmv;
+				TimeService::LocalTime(static_cast<std::time_t>(sec), tmv);
+				len_ = Strftime(before_, tmv, buf_, bufSize);
+				fracPos_ = len_;
+				if (fracDigits_ > 0 && len_ + fracDigits_ < bufSize)
+				{
+					len_ += fracDigits_;
+					len_ += Strftime(after_, tmv, buf_ + len_, bufSize - len_);
+				}
+				cachedSec_ = sec;
+			}
+
+			if (fracDigits_ > 0 && fracPos_ + fracDigits_ <= len_)
+			{
+				int64_t frac = (tsNs - sec * 1000000000) / (fracDigits_ == 3 ? 1000000 : 1000);
+				for (int i = fracDigits_ - 1; i >= 0; i--)
+				{
+					buf_[fracPos_ + i] = static_cast<char>('0' + frac % 10);
+					frac /= 10;
+				}
+			}
+			return std::string_view(buf_, len_);
+		}
+	};
+}
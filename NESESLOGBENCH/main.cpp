@@ -0,0 +1,338 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include "Neses/Logger.hpp"
+#include "Neses/TimeService.hpp"
+
+/*
+Logger throughput and latency benchmark.
+
+	NESESLOGBENCH [-threads 4] [-messages 100000] [-sizes 16,128,1024] [-sinks null,file,console]
+	              [-apis log,dlog,logf,stream] [-overflow countAndDrop|drop|block] [-dir ./benchlogs] [-keep]
+
+Every sink / api / message size runs with 1, 2, 4 .. -threads producer threads, each logging -messages
+records after a short warm up. A run starts the Logger (null: no sink, the records are only consumed),
+times every call on the caller side and stops the Logger, which writes out whatever is still queued.
+
+	calls/s		records per second the producers managed
+	drained/s	records per second up to the end of Stop, the sustained rate of the sink
+	p50 .. max	caller side latency of one call in ns, clock reading included
+	drops		records discarded by the overflow policy plus lines the sinks dropped
+	allocs/msg	operator new calls per record on the caller side, and up to the end of Stop
+
+Log files go to a new folder of this run below -dir, removed at the end unless -keep is given.
+Allocations inside NESESLIB (time zone, file open) are not seen by this executable on Windows.
+Use the console sink with the output redirected, the results go to stderr.
+*/
+
+using namespace NESES;
+
+namespace
+{
+	std::atomic<uint64_t> allocCount{ 0 };
+}
+
+void* operator new(std::size_t size)
+{
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size == 0 ? 1 : size))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+	enum class Api { log, dlog, logf, stream };
+
+	struct Options
+	{
+		int maxThreads = 4;
+		size_t messages = 100000;
+		std::vector<size_t> sizes{ 16, 128, 1024 };
+		std::vector<std::string> sinks{ "null", "file" };
+		std::vector<std::string> apis{ "log", "dlog", "logf", "stream" };
+		LogOverflowPolicy overflow = LogOverflowPolicy::countAndDrop;
+		std::string dir = "./benchlogs";
+		bool keep = false;
+	};
+
+	struct Result
+	{
+		double callsPerSec = 0;
+		double drainedPerSec = 0;
+		int64_t p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+		uint64_t drops = 0;
+		double callerAllocs = 0;
+		double totalAllocs = 0;
+	};
+
+	constexpr size_t WarmupMessages = 2000;
+
+	void Usage()
+	{
+		std::cerr << "usage: NESESLOGBENCH [-threads n] [-messages n] [-sizes 16,128,...] [-sinks null,file,console]"
+			<< " [-apis log,dlog,logf,stream] [-overflow countAndDrop|drop|block] [-dir path] [-keep]" << std::endl;
+	}
+
+	std::vector<std::string> SplitList(const std::string& s)
+	{
+		std::vector<std::string> out;
+		std::stringstream ss(s);
+		std::string item;
+		while (std::getline(ss, item, ','))
+		{
+			if (!item.empty())
+				out.push_back(item);
+		}
+		return out;
+	}
+
+	bool ParseApi(const std::string& name, Api& api)
+	{
+		if (name == "log") api = Api::log;
+		else if (name == "dlog") api = Api::dlog;
+		else if (name == "logf") api = Api::logf;
+		else if (name == "stream") api = Api::stream;
+		else return false;
+		return true;
+	}
+
+	bool ParseArgs(int argc, char** argv, Options& opt)
+	{
+		try
+		{
+			for (int i = 1; i < argc; i++)
+			{
+				std::string arg = argv[i];
+				bool hasValue = i + 1 < argc;
+				if (arg == "-keep")
+					opt.keep = true;
+				else if (!hasValue)
+					return false;
+				else if (arg == "-threads")
+					opt.maxThreads = std::stoi(argv[++i]);
+				else if (arg == "-messages")
+					opt.messages = std::stoul(argv[++i]);
+				else if (arg == "-sizes")
+				{
+					opt.sizes.clear();
+					for (const auto& size : SplitList(argv[++i]))
+						opt.sizes.push_back(std::stoul(size));
+				}
+				else if (arg == "-sinks")
+					opt.sinks = SplitList(argv[++i]);
+				else if (arg == "-apis")
+					opt.apis = SplitList(argv[++i]);
+				else if (arg == "-dir")
+					opt.dir = argv[++i];
+				else if (arg == "-overflow")
+				{
+					std::string policy = argv[++i];
+					if (policy == "countAndDrop") opt.overflow = LogOverflowPolicy::countAndDrop;
+					else if (policy == "drop") opt.overflow = LogOverflowPolicy::drop;
+					else if (policy == "block") opt.overflow = LogOverflowPolicy::block;
+					else return false;
+				}
+				else
+					return false;
+			}
+		}
+		catch (const std::exception&)
+		{
+			return false;
+		}
+
+		Api api;
+		for (const auto& name : opt.apis)
+		{
+			if (!ParseApi(name, api)) return false;
+		}
+		for (const auto& sink : opt.sinks)
+		{
+			if (sink != "null" && sink != "file" && sink != "console") return false;
+		}
+		return opt.maxThreads > 0 && opt.messages > 0 && !opt.sizes.empty() && !opt.sinks.empty() && !opt.apis.empty();
+	}
+
+	// one record through the chosen api, text is the payload of the given size
+	inline void LogOne(Api api, const std::string& text, size_t i)
+	{
+		switch (api)
+		{
+		case Api::log:
+			Logger::Instance().log(text, LogType::info);
+			break;
+		case Api::dlog:
+			NESESDLOG(text);
+			break;
+		case Api::logf:
+			NESESLOGF(LogType::info, "bench {} {}", i, std::string_view(text));
+			break;
+		case Api::stream:
+			NESESLOG_STREAM(LogType::info) << "bench " << i << ' ' << text;
+			break;
+		}
+	}
+
+	void Produce(Api api, const std::string& text, size_t count, std::atomic<int>& ready, const std::atomic<bool>& go, std::vector<int64_t>& latency)
+	{
+		for (size_t i = 0; i < WarmupMessages; i++)
+			LogOne(api, text, i);
+		ready.fetch_add(1);
+		while (!go.load(std::memory_order_acquire))
+			std::this_thread::yield();
+
+		for (size_t i = 0; i < count; i++)
+		{
+			int64_t start = TimeService::MonotonicNs();
+			LogOne(api, text, i);
+			latency[i] = TimeService::MonotonicNs() - start;
+		}
+	}
+
+	uint64_t SinkDrops()
+	{
+		uint64_t dropped = 0;
+		for (const auto& sink : Logger::Instance().GetSinks())
+			dropped += sink->Dropped();
+		return dropped;
+	}
+
+	int64_t Percentile(std::vector<int64_t>& values, double p)
+	{
+		size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+		std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+		return values[index];
+	}
+
+	Result Run(const Options& opt, const std::string& sink, Api api, int threads, size_t size)
+	{
+		Logger& logger = Logger::Instance();
+		logger.SetOverflowPolicy(opt.overflow);
+		logger.Init(nullptr, (std::filesystem::path(opt.dir) / "").string(), sink == "console", sink == "file");
+
+		std::string text(size, 'x');
+		std::vector<std::vector<int64_t>> latency(static_cast<size_t>(threads), std::vector<int64_t>(opt.messages));
+		std::vector<std::thread> producers;
+		std::atomic<int> ready{ 0 };
+		std::atomic<bool> go{ false };
+		for (int t = 0; t < threads; t++)
+		{
+			producers.emplace_back(Produce, api, std::cref(text), opt.messages, std::ref(ready), std::cref(go),
+				std::ref(latency[static_cast<size_t>(t)]));
+		}
+		while (ready.load() < threads)
+			std::this_thread::yield();
+
+		// warm up records are still queued, let the logger catch up before the timed part
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		uint64_t droppedBefore = logger.DroppedCount() + SinkDrops();
+		uint64_t allocsBefore = allocCount.load();
+		int64_t start = TimeService::MonotonicNs();
+		go.store(true, std::memory_order_release);
+		for (auto& th : producers)
+			th.join();
+		int64_t produced = TimeService::MonotonicNs();
+		uint64_t allocsProduced = allocCount.load();
+		logger.Stop();
+		int64_t drained = TimeService::MonotonicNs();
+		uint64_t allocsDrained = allocCount.load();
+
+		Result res;
+		double total = static_cast<double>(opt.messages) * threads;
+		res.callsPerSec = total * 1e9 / static_cast<double>(std::max<int64_t>(produced - start, 1));
+		res.drainedPerSec = total * 1e9 / static_cast<double>(std::max<int64_t>(drained - start, 1));
+		res.drops = logger.DroppedCount() + SinkDrops() - droppedBefore;
+		res.callerAllocs = static_cast<double>(allocsProduced - allocsBefore) / total;
+		res.totalAllocs = static_cast<double>(allocsDrained - allocsBefore) / total;
+
+		std::vector<int64_t> all;
+		all.reserve(static_cast<size_t>(total));
+		for (const auto& values : latency)
+			all.insert(all.end(), values.begin(), values.end());
+		res.p50 = Percentile(all, 0.50);
+		res.p90 = Percentile(all, 0.90);
+		res.p99 = Percentile(all, 0.99);
+		res.p999 = Percentile(all, 0.999);
+		res.max = *std::max_element(all.begin(), all.end());
+		return res;
+	}
+
+	void PrintHeader()
+	{
+		std::cerr << std::left << std::setw(8) << "sink" << std::setw(7) << "api" << std::right
+			<< std::setw(4) << "thr" << std::setw(6) << "size"
+			<< std::setw(12) << "calls/s" << std::setw(12) << "drained/s"
+			<< std::setw(8) << "p50" << std::setw(8) << "p90" << std::setw(8) << "p99" << std::setw(9) << "p99.9" << std::setw(10) << "max"
+			<< std::setw(10) << "drops" << std::setw(14) << "allocs/msg" << std::endl;
+	}
+
+	void PrintResult(const std::string& sink, const std::string& api, int threads, size_t size, const Result& res)
+	{
+		std::ostringstream allocs;
+		allocs << std::fixed << std::setprecision(2) << res.callerAllocs << " / " << res.totalAllocs;
+		std::cerr << std::left << std::setw(8) << sink << std::setw(7) << api << std::right
+			<< std::setw(4) << threads << std::setw(6) << size << std::fixed << std::setprecision(0)
+			<< std::setw(12) << res.callsPerSec << std::setw(12) << res.drainedPerSec
+			<< std::setw(8) << res.p50 << std::setw(8) << res.p90 << std::setw(8) << res.p99 << std::setw(9) << res.p999 << std::setw(10) << res.max
+			<< std::setw(10) << res.drops << std::setw(14) << allocs.str() << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options opt;
+	if (!ParseArgs(argc, argv, opt))
+	{
+		Usage();
+		return 2;
+	}
+
+	// a folder of its own, -dir may hold other files
+	std::error_code ec;
+	std::filesystem::path runDir = std::filesystem::path(opt.dir)
+		/ ("NESESLOGBENCH-" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()));
+	std::filesystem::create_directories(opt.dir, ec);
+	if (ec || !std::filesystem::create_directory(runDir, ec))
+	{
+		std::cerr << "Log directory not created : " << runDir.string() << " " << ec.message() << std::endl;
+		return 1;
+	}
+	opt.dir = runDir.string();
+
+	PrintHeader();
+	for (const auto& sink : opt.sinks)
+	{
+		for (const auto& name : opt.apis)
+		{
+			Api api;
+			ParseApi(name, api);
+			for (size_t size : opt.sizes)
+			{
+				for (int threads = 1; ; threads = std::min(threads * 2, opt.maxThreads))
+				{
+					Result res = Run(opt, sink, api, threads, size);
+					PrintResult(sink, name, threads, size, res);
+					if (threads == opt.maxThreads) break;
+				}
+			}
+		}
+	}
+
+	if (!opt.keep)
+		std::filesystem::remove_all(runDir, ec);
+	return 0;
+}
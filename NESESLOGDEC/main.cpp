@@ -0,0 +1,177 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstdint>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include "Neses/LogBinary.hpp"
+#include "Neses/LogLevel.hpp"
+#include "Neses/TimeService.hpp"
+
+/*
+Renders binary log files (Logger::UseBinaryFile) in the text layout of the Logger.
+
+	NESESLOGDEC [-from "2024-05-01 10:00:00"] [-to "2024-05-01 11:00:00"] [-level warning]
+	            [-timeformat "[%Y-%m-%d %H:%M:%S]"] file.nlog [file.nlog.gz ...]
+
+-from / -to are local time ("%Y-%m-%d %H:%M:%S" or "%Y-%m-%d"), -level is the lowest level printed.
+*/
+
+using namespace NESES;
+
+namespace
+{
+	struct Options
+	{
+		int64_t fromNs = INT64_MIN;
+		int64_t toNs = INT64_MAX;
+		int minSeverity = NESES_LOG_LEVEL_TRACE;
+		std::string timeFormat = "[%Y-%m-%d %H:%M:%S]";
+		std::vector<std::string> files;
+	};
+
+	void Usage()
+	{
+		std::cerr << "usage: NESESLOGDEC [-from time] [-to time] [-level trace|debug|info|userevent|warning|error]"
+			<< " [-timeformat format] file..." << std::endl;
+	}
+
+	bool ParseTime(const std::string& text, int64_t& ns)
+	{
+		std::tm tmv{};
+		std::istringstream in(text);
+		in >> std::get_time(&tmv, "%Y-%m-%d %H:%M:%S");
+		if (in.fail())
+		{
+			tmv = std::tm{};
+			std::istringstream date(text);
+			date >> std::get_time(&tmv, "%Y-%m-%d");
+			if (date.fail()) return false;
+		}
+		tmv.tm_isdst = -1;
+		std::time_t t = std::mktime(&tmv);
+		if (t == static_cast<std::time_t>(-1)) return false;
+		ns = static_cast<int64_t>(t) * 1000000000;
+		return true;
+	}
+
+	bool ParseLevel(const std::string& text, int& severity)
+	{
+		static const std::pair<const char*, LogType> names[] = {
+			{ "trace", LogType::trace }, { "debug", LogType::debug }, { "info", LogType::info },
+			{ "userevent", LogType::userevent }, { "warning", LogType::warning }, { "error", LogType::error } };
+		for (const auto& n : names)
+		{
+			if (text == n.first)
+			{
+				severity = LogSeverity(n.second);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ParseArgs(int argc, char** argv, Options& opt)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (arg == "-from" && hasValue)
+			{
+				if (!ParseTime(argv[++i], opt.fromNs)) return false;
+			}
+			else if (arg == "-to" && hasValue)
+			{
+				if (!ParseTime(argv[++i], opt.toNs)) return false;
+			}
+			else if (arg == "-level" && hasValue)
+			{
+				if (!ParseLevel(argv[++i], opt.minSeverity)) return false;
+			}
+			else if (arg == "-timeformat" && hasValue)
+			{
+				opt.timeFormat = argv[++i];
+			}
+			else if (!arg.empty() && arg[0] == '-')
+			{
+				return false;
+			}
+			else
+			{
+				opt.files.push_back(arg);
+			}
+		}
+		return !opt.files.empty();
+	}
+
+	bool EndsWith(const std::string& s, const std::string& end)
+	{
+		return s.size() >= end.size() && s.compare(s.size() - end.size(), end.size(), end) == 0;
+	}
+
+	bool Decode(const std::string& file, const Options& opt, CachedTimeFormat& timeFormat, std::string& line)
+	{
+		std::ifstream raw(file, std::ios::binary);
+		if (!raw)
+		{
+			std::cerr << "Cannot open " << file << std::endl;
+			return false;
+		}
+		boost::iostreams::filtering_istream in;
+		if (EndsWith(file, ".gz"))
+			in.push(boost::iostreams::gzip_decompressor());
+		in.push(raw);
+
+		LogBinaryReader reader(in);
+		LogRecord rec;
+		while (reader.Next(rec))
+		{
+			if (rec.timestamp >= opt.fromNs && rec.timestamp < opt.toNs && LogSeverity(rec.type) >= opt.minSeverity)
+			{
+				line.clear();
+				FormatLogLine(rec, timeFormat.Format(rec.timestamp), line);
+				line.push_back('\n');
+				std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+			}
+			rec.Release();
+		}
+		if (reader.Error())
+		{
+			std::cerr << file << " : not a binary log or cut inside an entry" << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options opt;
+	if (!ParseArgs(argc, argv, opt))
+	{
+		Usage();
+		return 2;
+	}
+
+	std::ios::sync_with_stdio(false);
+	CachedTimeFormat timeFormat(opt.timeFormat);
+	std::string line;
+	bool ok = true;
+	try
+	{
+		for (const auto& file : opt.files)
+			ok = Decode(file, opt, timeFormat, line) && ok;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Decode error : " << e.what() << std::endl;
+		ok = false;
+	}
+	std::cout.flush();
+	return ok ? 0 : 1;
+}
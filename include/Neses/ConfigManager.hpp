@@ -3,6 +3,7 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <vector>
 #include "Exporter.h"
 
 namespace NESES
@@ -25,5 +26,8 @@ namespace NESES
 		NESESAPI static std::string GetValue(const std::string& path, const std::string& defval="");
 		NESESAPI static void UpdateValue(const std::string& path, const std::string& val);
 
+		// element names directly under path, e.g. the lane names under CONFIG.EXECUTORS
+		NESESAPI static std::vector<std::string> GetChildNames(const std::string& path);
+
 	};
 }
@@ -0,0 +1,304 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <climits>
+#include <atomic>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+#include "App.hpp"
+#include "DirWatcher.hpp"
+#include "NesesThread.hpp"
+
+/*
+Many watched directories on one thread. A DirWatcher takes a thread of its own and the ThreadManager
+has only a few, the service runs its watchers one round at a time instead: every watcher keeps its own
+folder, interval, filters, mode and callbacks, the service waits for the earliest due one or for any
+kernel notification (all inotify descriptors in one poll). Callbacks run on the service thread, a slow
+one holds up the other folders. Folder reads of a scan still spread over the io lane.
+
+	DirWatchService service("inputs");
+	auto w = service.NewWatcher("orders");
+	w->SetDirUtil(ctx);
+	w->SetInterval(std::chrono::milliseconds(500));
+	w->SetFileCB(cb, FileStatus::created);
+	service.Add(w);		// before or after Start
+	service.Start();
+*/
+
+namespace NESES
+{
+	class DirWatchService
+	{
+	private:
+		struct Entry
+		{
+			std::shared_ptr<DirWatcher> watcher;
+			std::chrono::steady_clock::time_point due;
+			bool signaled{ false };		// kernel events waiting
+		};
+
+		std::string name;
+		std::shared_ptr<NesesThread> thHandle;
+		std::vector<std::shared_ptr<DirWatcher>> watchers;		// under mtx
+		uint64_t version{ 0 };									// watchers changes, under mtx
+		uint64_t appliedVersion{ 0 };							// changes the service thread took over
+		std::mutex mtx;
+		std::condition_variable changed;
+		bool woken{ false };
+		std::atomic<std::thread::id> loopId{};				// service thread, read by Add / Remove
+		std::vector<Entry> entries;								// service thread
+#ifdef __linux__
+		int wakeFd_{ -1 };
+		std::vector<pollfd> fds;
+#endif
+		std::atomic<bool> IsStarted{ false };
+
+		// watchers added or removed since the last round, their initial scan and final flush run here
+		void ApplyChanges()
+		{
+			std::vector<std::shared_ptr<DirWatcher>> current;
+			uint64_t v;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				if (version == appliedVersion)
+					return;
+				current = watchers;
+				v = version;
+			}
+
+			for (auto it = entries.begin(); it != entries.end(); )
+			{
+				if (std::find(current.begin(), current.end(), it->watcher) == current.end())
+				{
+					it->watcher->EndWatch();
+					it->watcher->IsStarted = false;
+					it = entries.erase(it);
+				}
+				else
+					++it;
+			}
+			for (auto& w : current)
+			{
+				if (std::find_if(entries.begin(), entries.end(), [&w](const Entry& e) { return e.watcher == w; }) != entries.end())
+					continue;
+				w->DoGetFiles();
+				w->BeginWatch();
+				w->IsStarted = true;
+				Entry e;
+				e.watcher = w;
+				e.due = std::chrono::steady_clock::now();
+				entries.push_back(std::move(e));
+			}
+
+			std::lock_guard<std::mutex> lock(mtx);
+			appliedVersion = v;
+			changed.notify_all();
+		}
+
+		// until next, a wake or kernel events on any watcher
+		void WaitUntil(std::chrono::steady_clock::time_point next)
+		{
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+			int timeout = static_cast<int>(std::clamp<long long>(left.count(), 0, INT_MAX));
+#ifdef __linux__
+			fds.clear();
+			fds.push_back({ wakeFd_, POLLIN, 0 });
+			for (const auto& e : entries)
+				fds.push_back({ e.watcher->notifier.Handle(), POLLIN, 0 });		// -1 for polling ones, ignored
+			if (::poll(fds.data(), fds.size(), timeout) <= 0)
+				return;
+			if (fds[0].revents & POLLIN)
+			{
+				uint64_t value;
+				while (::read(wakeFd_, &value, sizeof(value)) > 0) {}
+			}
+			for (size_t i = 0; i < entries.size(); i++)
+				entries[i].signaled = fds[i + 1].revents != 0;
+#else
+			std::unique_lock<std::mutex> lock(mtx);
+			changed.wait_for(lock, std::chrono::milliseconds(timeout), [this]() { return woken; });
+			woken = false;
+#endif
+		}
+
+		void ServiceRoutine(std::shared_ptr<NesesThread>& nesesth)
+		{
+			loopId = std::this_thread::get_id();
+			while (nesesth->GetStopFlag() == false)
+			{
+				ApplyChanges();
+				auto now = std::chrono::steady_clock::now();
+				auto next = now + std::chrono::seconds(1);		// picks up new watchers without a wake as well
+				for (auto& e : entries)
+				{
+					if (nesesth->GetStopFlag())
+						break;
+					if (e.signaled || e.due <= now)
+					{
+						e.signaled = false;
+						e.due = e.watcher->Pass(nesesth, false);
+					}
+					next = std::min(next, e.due);
+				}
+				if (nesesth->GetStopFlag())
+					break;
+				WaitUntil(next);
+			}
+
+			for (auto& e : entries)
+			{
+				e.watcher->EndWatch();
+				e.watcher->IsStarted = false;
+			}
+			entries.clear();
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				appliedVersion = version;
+				changed.notify_all();
+			}
+			nesesth->SetIsDone(true);
+		}
+
+		void Wake()
+		{
+#ifdef __linux__
+			if (wakeFd_ >= 0)
+			{
+				uint64_t one = 1;
+				ssize_t res = ::write(wakeFd_, &one, sizeof(one));
+				(void)res;
+			}
+#else
+			std::lock_guard<std::mutex> lock(mtx);
+			woken = true;
+			changed.notify_all();
+#endif
+		}
+
+		// waits until the service thread took the change over, not from a callback of its own
+		void WaitApplied(std::unique_lock<std::mutex>& lock)
+		{
+			Wake();
+			if (!IsStarted || std::this_thread::get_id() == loopId)
+				return;
+			uint64_t v = version;
+			changed.wait(lock, [this, v]() { return appliedVersion >= v; });
+		}
+
+	public:
+		DirWatchService()
+			: DirWatchService{ "NoName" }
+		{
+		}
+		DirWatchService(std::string aName)
+			: name(aName)
+		{
+#ifdef __linux__
+			wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+			auto res = App::Instance().NewWorker("DirWatchService-" + name);
+			if (res)
+			{
+				thHandle = res;
+				thHandle->Set(&DirWatchService::ServiceRoutine, this, std::ref(thHandle));
+				thHandle->RegisterNotifierCB([this]() { Wake(); });
+			}
+			else
+			{
+				std::cerr << "Cannot get new thread for DirWatchService" << std::endl;
+			}
+		}
+		~DirWatchService()
+		{
+			Stop();
+#ifdef __linux__
+			if (wakeFd_ >= 0) ::close(wakeFd_);
+#endif
+		}
+
+		DirWatchService(const DirWatchService&) = delete;
+		DirWatchService& operator=(const DirWatchService&) = delete;
+
+		// a watcher without a thread of its own, set it up and Add it
+		std::shared_ptr<DirWatcher> NewWatcher(const std::string& aName)
+		{
+			return std::shared_ptr<DirWatcher>(new DirWatcher(aName, DirWatcher::NoThread{}));
+		}
+
+		// false for a watcher with its own thread, an invalid folder or one already added
+		bool Add(const std::shared_ptr<DirWatcher>& watcher)
+		{
+			if (!watcher || watcher->thHandle || !watcher->dirContext.IsValid())
+				return false;
+			std::unique_lock<std::mutex> lock(mtx);
+			if (std::find(watchers.begin(), watchers.end(), watcher) != watchers.end())
+				return false;
+			watchers.push_back(watcher);
+			version++;
+			WaitApplied(lock);
+			return true;
+		}
+
+		// no callbacks of watcher after it returns (unless called from one of them)
+		bool Remove(const std::shared_ptr<DirWatcher>& watcher)
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			auto it = std::find(watchers.begin(), watchers.end(), watcher);
+			if (it == watchers.end())
+				return false;
+			watchers.erase(it);
+			version++;
+			WaitApplied(lock);
+			return true;
+		}
+
+		void Start()
+		{
+			if (IsStarted)
+				return;
+			if (!thHandle)
+			{
+				std::cerr << "DirWatchService: no thread for " << name << std::endl;
+				return;
+			}
+			IsStarted = true;
+			thHandle->Start();
+		}
+
+		void Stop()
+		{
+			if (IsStarted == false)
+				return;
+			if (thHandle)
+			{
+				thHandle->Stop();
+				while (thHandle->GetIsDone() == false)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				}
+				thHandle.reset();
+			}
+			IsStarted = false;
+		}
+
+		bool GetIsStarted() const
+		{
+			return IsStarted;
+		}
+
+		size_t GetWatcherCount()
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			return watchers.size();
+		}
+	};
+}
@@ -1,19 +1,33 @@
 ﻿#pragma once
 #include <filesystem>
 #include <chrono>
+#include <algorithm>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <atomic>
 #include "App.hpp"
 #include "CallBack.hpp"
 #include "NesesString.hpp"
 #include "FileInfo.hpp"
 #include "FileList.hpp"
 #include "DirContext.hpp"
+#include "DirNotifier.hpp"
+#include "DirScanner.hpp"
+#include "DirSnapshot.hpp"
 #include "NesesIO.hpp"
 #include "NesesThread.hpp"
 
 namespace NESES
 {
+    // automatic: kernel notification (inotify) on local file systems, polling on network ones
+    enum class DirWatchMode
+    {
+        automatic,
+        polling,
+        notify
+    };
+
     class DirWatcher
     {
     private:
@@ -25,11 +39,34 @@ namespace NESES
         CallBack<FileInfo> FileCreatedCB;
         CallBack<FileInfo> FileErasedCB;
         CallBack<FileInfo> FileModifiedCB;
+        CallBack<FileInfo> FileReadyCB;
         CallBack<std::string> MessageCB;
         std::shared_ptr<NesesThread> thHandle;
+        DirWatchMode watchMode{ DirWatchMode::automatic };
+        DirScanner scanner;
+        DirNotifier notifier;
+        bool useNotifier{ false };
+        std::vector<DirEvent> events;                               // watcher thread
+        std::vector<std::filesystem::path> pendingModified;         // written files, reported once per delay
+        std::chrono::steady_clock::time_point pendingDue;
+        std::chrono::steady_clock::time_point nextScan;             // polling mode
+        std::filesystem::path snapshotFile;                         // empty, no snapshot
+        std::chrono::milliseconds snapshotInterval{ 0 };
+        std::chrono::steady_clock::time_point nextSnapshot;
+        bool snapshotDirty{ false };
+
+        // stable file mode, files written since their last ready event
+        struct Unsettled
+        {
+            FileInfo fi;
+            std::chrono::steady_clock::time_point since;    // last size / time change seen
+            bool wasReady{ false };                         // reported ready before, erased is reported
+        };
+        std::chrono::milliseconds quietPeriod{ 0 };
+        std::unordered_map<size_t, Unsettled> unsettled;    // by path hash
 
         bool IsComplete{ false };
-        bool IsStarted{ false };
+        std::atomic<bool> IsStarted{ false };     // written by the DirWatchService thread too
 
         bool IsExtOk(std::string anExt)
         {
@@ -47,29 +84,33 @@ namespace NESES
             }
             return back;
         }
+        bool AcceptPath(const std::filesystem::path& fpath)
+        {
+            return IsExtOk(fpath.extension().string());
+        }
         void GetFiles(const std::string& dirpath, BackObject& back)
         {
-            FileInfo fi;
-            for (auto& file : std::filesystem::directory_iterator(dirpath))
+            DirScanResult res = scanner.Scan(dirpath, [this](const std::filesystem::path& p) { return AcceptPath(p); });
+            back.Success = !res.dirs.empty();
+            if (!back.Success)
             {
-                if (std::filesystem::is_regular_file(file))
+                back.ErrDesc = "Cannot read " + dirpath;
+                return;
+            }
+            if (!res.complete)
+                FireMessageCB("Some folders could not be read under " + dirpath);
+            for (const auto& fi : res.files)
+            {
+                BackObject added = files.AddItem(fi);
+                if (added.Success == false)
                 {
-                    if (IsExtOk(file.path().extension().string()))
-                    {
-                        fi.fpath = file.path();
-                        fi.setFileTime(std::filesystem::last_write_time(file));
-                        fi.hash = std::filesystem::hash_value(file);
-                        back = files.AddItem(fi);
-                        if (back.Success == false)
-                        {
-                            std::cout << back.ErrDesc << std::endl;
-                        }
-                    }
+                    std::cout << added.ErrDesc << std::endl;
                 }
             }
         }
         void FireCallback(FileInfo& arg)
         {
+            snapshotDirty = true;
             switch (arg.fs)
             {
             case FileStatus::created:
@@ -87,114 +128,479 @@ namespace NESES
                 FileModifiedCB.invoke(arg);
                 break;
             }
+            case FileStatus::ready:
+            {
+                FileReadyCB.invoke(arg);
+                break;
+            }
+            default:
+                break;
             }
         }
         void FireMessageCB(const std::string& aStr)
         {
             MessageCB.invoke(aStr);
         }
-        void WatchRoutine(std::shared_ptr<NesesThread>& nesesth)
+        // one entry of the directory, added or compared to the known one, seen in the current scan
+        void ApplyEntry(FileInfo& fi)
         {
-            BackObject back;
-            FireMessageCB("Directory watcher " + name + " for " + dirContext.dirPath.string() + " started");
+            FileInfo* pfi = files.Visit(fi);
 
-            while (nesesth->GetStopFlag() == false)
+            // yoksa ekle
+            if (pfi == nullptr)
             {
-                /////////////////////////////////// watchpath control
-                if (!dirContext.IsValid())
+                BackObject back = files.AddItem(fi);
+                if (back.Success == true)
                 {
-                    FireMessageCB("Watchpath is not avaliable : " + dirContext.dirPath.string());
-                    std::this_thread::sleep_for(delay);
-                    continue;
+                    if (quietPeriod.count() > 0)
+                    {
+                        Unsettle(fi, false);
+                        return;
+                    }
+                    fi.fs = FileStatus::created;
+                    FireCallback(fi);
                 }
-                /// ////////////////////////////////////////
-
-                // önce listeyi dön ve değişiklikleri uygula
-                for (int i = 0; i < files.GetSize(); i++)
+                else
                 {
-                    FileInfo& fi = files.Front();
-
-                    // gündönümünde path değişmiş olabilir
-                    if (IOUtil::PathCompare(fi.fpath.parent_path(), dirContext.dirPath) != 0) // old path items to be removed -- gundönümü
+                    std::cout << back.ErrDesc << std::endl;
+                }
+            }
+            else // varsa ve değişmişse guncelle
+            {
+                if (pfi->GetFileTime() != fi.GetFileTime() || pfi->size != fi.size || pfi->inode != fi.inode)   // inode: replaced by rename
+                {
+                    pfi->fpath = fi.fpath;
+                    pfi->hash = fi.hash;
+                    pfi->size = fi.size;
+                    pfi->inode = fi.inode;
+                    pfi->setFileTime(fi.GetFileTime());
+                    if (quietPeriod.count() > 0)
                     {
-                        fi.IsDeleted = true;
-                        fi.fs = FileStatus::erased;
-                        files.PopFront();
-                        FireMessageCB("file will be removed from list due to path change: " + fi.fpath.string());
-                        continue;
+                        Unsettle(fi, true);
+                        return;
                     }
+                    fi.fs = FileStatus::modified;
+                    FireCallback(fi);
+                }
+            }
+        }
 
-                    if (fi.IsDeleted)
-                    {
-                        files.PopFront();
-                        continue;
-                    }
+        // stable file mode, created / modified wait here until the file is quiet
+        void Unsettle(const FileInfo& fi, bool known)
+        {
+            auto it = unsettled.find(fi.hash);
+            if (it == unsettled.end())
+            {
+                unsettled.emplace(fi.hash, Unsettled{ fi, std::chrono::steady_clock::now(), known });
+                return;
+            }
+            it->second.fi = fi;
+            it->second.since = std::chrono::steady_clock::now();
+        }
 
-                    if (!std::filesystem::exists(fi.fpath))
+        // same size and time as last seen, or closed, one ready event
+        void FireReady(std::unordered_map<size_t, Unsettled>::iterator it)
+        {
+            FileInfo fi = it->second.fi;
+            unsettled.erase(it);
+            fi.fs = FileStatus::ready;
+            FireCallback(fi);
+        }
+
+        // unsettled files quiet for quietPeriod are looked at once more
+        void CheckUnsettled()
+        {
+            auto now = std::chrono::steady_clock::now();
+            for (auto it = unsettled.begin(); it != unsettled.end(); )
+            {
+                Unsettled& u = it->second;
+                if (now - u.since < quietPeriod)
+                {
+                    ++it;
+                    continue;
+                }
+                FileInfo cur;
+                if (!DirScanner::StatFile(u.fi.fpath, cur))
+                {
+                    u.since = now;      // gone, the erase handling removes it; looked at again after quiet, not every pass
+                    ++it;
+                    continue;
+                }
+                if (cur.GetFileTime() != u.fi.GetFileTime() || cur.size != u.fi.size)
+                {
+                    u.fi.setFileTime(cur.GetFileTime());
+                    u.fi.size = cur.size;
+                    u.fi.inode = cur.inode;
+                    u.since = now;
+                    if (FileInfo* pfi = files.GetIfContains(u.fi))
                     {
-                        fi.IsDeleted = true;
-                        fi.fs = FileStatus::erased;
-                        files.PopFront();
-                        FireCallback(fi);
+                        pfi->size = cur.size;
+                        pfi->inode = cur.inode;
+                        pfi->setFileTime(cur.GetFileTime());
                     }
+                    ++it;
+                    continue;
                 }
+                auto ready = it++;
+                FireReady(ready);
+            }
+        }
 
-                if (nesesth->GetStopFlag())
-                    break;
+        // time until the next unsettled file is due, delay if none
+        std::chrono::milliseconds NextUnsettledDue()
+        {
+            std::chrono::milliseconds next = delay;
+            auto now = std::chrono::steady_clock::now();
+            for (const auto& u : unsettled)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(u.second.since + quietPeriod - now);
+                next = std::min(next, std::max(left, std::chrono::milliseconds(0)));
+            }
+            return next;
+        }
 
-                // klasörü tara
-                FileInfo fi;
-                FileInfo* pfi;
+        // erased is reported for files reported before, a file gone while still unsettled was never announced
+        void FireErased(FileInfo& fi)
+        {
+            auto it = unsettled.find(fi.hash);
+            if (it != unsettled.end())
+            {
+                bool wasReady = it->second.wasReady;
+                unsettled.erase(it);
+                if (!wasReady)
+                    return;
+            }
+            fi.IsDeleted = true;
+            fi.fs = FileStatus::erased;
+            FireCallback(fi);
+        }
 
-                for (auto& file : std::filesystem::directory_iterator(dirContext.dirPath))
-                {
-                    fi.clear();
-                    pfi = nullptr;
-                    if (std::filesystem::is_regular_file(file))
+        // full pass, the polling mode runs it every delay, the notify mode after a lost event
+        void ScanOnce(std::shared_ptr<NesesThread>& nesesth)
+        {
+            // klasörü tara, görülmeyenler silinmiş
+            DirScanResult res = scanner.Scan(dirContext.dirPath,
+                [this](const std::filesystem::path& p) { return AcceptPath(p); },
+                [&nesesth]() { return nesesth->GetStopFlag(); });
+            if (nesesth->GetStopFlag())
+                return;
+
+            files.BeginScan();
+            for (auto& fi : res.files)
+                ApplyEntry(fi);
+
+            // an unreadable folder is not a deleted one
+            if (res.complete)
+            {
+                files.Sweep([this](FileInfo& gone)
                     {
-                        if (IsExtOk(file.path().extension().string()))
+                        // gündönümünde path değişmiş olabilir
+                        if (DirScanner::DepthOf(dirContext.dirPath, gone.fpath) < 0)
                         {
-                            fi.fpath = file.path();
-                            fi.setFileTime(std::filesystem::last_write_time(file));
-                            fi.hash = std::filesystem::hash_value(file);
-
-                            pfi = files.GetIfContains(fi);
-
-                            // yoksa ekle
-                            if (pfi == nullptr)
-                            {
-                                back = files.AddItem(fi);
-                                if (back.Success == true)
-                                {
-                                    fi.fs = FileStatus::created;
-                                    FireCallback(fi);
-                                }
-                                else
-                                {
-                                    std::cout << back.ErrDesc << std::endl;
-                                }
-                            }
-                            else // varsa ve değişmişse guncelle
-                            {
-                                if (pfi->GetFileTime() != fi.GetFileTime())
-                                {
-                                    pfi->fpath = fi.fpath;
-                                    pfi->hash = fi.hash;
-                                    pfi->setFileTime(fi.GetFileTime());
-                                    fi.fs = FileStatus::modified;
-                                    FireCallback(fi);
-                                }
-                            }
+                            unsettled.erase(gone.hash);
+                            snapshotDirty = true;
+                            FireMessageCB("file will be removed from list due to path change: " + gone.fpath.string());
                         }
-                    }
+                        else
+                            FireErased(gone);
+                    });
+            }
+            WatchDirs(res.dirs);
+        }
+
+        // notify mode, every folder of a recursive watch needs its own inotify watch
+        void WatchDirs(const std::vector<std::filesystem::path>& dirs)
+        {
+            if (!notifier.IsOpen())
+                return;
+            for (const auto& dir : dirs)
+            {
+                if (!notifier.Add(dir))
+                {
+                    FireMessageCB("Cannot watch " + dir.string() + " (fs.inotify.max_user_watches?), polling " + dirContext.dirPath.string());
+                    notifier.Close();
+                    useNotifier = false;
+                    return;
                 }
+            }
+        }
+
+        // notify mode, a folder created or moved in below the root
+        void OnDirCreated(const std::filesystem::path& dir)
+        {
+            if (!scanner.AcceptsDir(dirContext.dirPath, dir) || !notifier.Add(dir))
+                return;
+            // files may have arrived before the watch
+            DirScanResult res = scanner.Scan(dirContext.dirPath, dir, DirScanner::DepthOf(dirContext.dirPath, dir),
+                [this](const std::filesystem::path& p) { return AcceptPath(p); });
+            for (auto& fi : res.files)
+                ApplyEntry(fi);
+            WatchDirs(res.dirs);
+        }
+
+        // notify mode, a folder moved out reports nothing for its files and its watches must go
+        void OnDirErased(const std::filesystem::path& dir)
+        {
+            notifier.Remove(dir);
+            std::vector<std::filesystem::path> gone;
+            for (auto it = files.Begin(); it != files.End(); ++it)
+            {
+                if (DirScanner::DepthOf(dir, it->fpath) > 0)
+                    gone.push_back(it->fpath);
+            }
+            for (const auto& fpath : gone)
+                OnErased(fpath);
+        }
+
+        // notified create / write, the file is looked at once
+        void OnChanged(const std::filesystem::path& fpath)
+        {
+            if (!AcceptPath(fpath) || !scanner.Accepts(dirContext.dirPath, fpath))
+                return;
+            FileInfo fi;
+            if (!DirScanner::StatFile(fpath, fi))
+                return;
+            fi.fpath = fpath;
+            fi.hash = std::filesystem::hash_value(fpath);
+            ApplyEntry(fi);
+        }
+
+        void OnErased(const std::filesystem::path& fpath)
+        {
+            pendingModified.erase(std::remove(pendingModified.begin(), pendingModified.end(), fpath), pendingModified.end());
+            FileInfo key;
+            key.hash = std::filesystem::hash_value(fpath);
+            FileInfo* pfi = files.GetIfContains(key);
+            if (pfi == nullptr)
+                return;
+            FileInfo fi = *pfi;
+            files.RemoveItem(fi);
+            FireErased(fi);
+        }
+
+        // stable file mode, the writer is done with it (IN_CLOSE_WRITE)
+        void OnClosed(const std::filesystem::path& fpath)
+        {
+            auto it = unsettled.find(std::filesystem::hash_value(fpath));
+            if (it != unsettled.end())
+                FireReady(it);
+        }
+
+        void AddPendingModified(const std::filesystem::path& fpath)
+        {
+            if (std::find(pendingModified.begin(), pendingModified.end(), fpath) != pendingModified.end())
+                return;
+            if (pendingModified.empty())
+                pendingDue = std::chrono::steady_clock::now() + delay;
+            pendingModified.push_back(fpath);
+        }
+
+        void FlushPendingModified(bool force)
+        {
+            if (pendingModified.empty() || (!force && std::chrono::steady_clock::now() < pendingDue))
+                return;
+            for (const auto& fpath : pendingModified)
+                OnChanged(fpath);
+            pendingModified.clear();
+        }
 
+        // one wait for kernel events; writes are reported at close or once per delay, not per write call
+        // longest kernel wait before a pending write or an unsettled file is due
+        std::chrono::milliseconds NotifyTimeout()
+        {
+            std::chrono::milliseconds timeout = delay;
+            if (!unsettled.empty())
+                timeout = NextUnsettledDue();
+            if (!pendingModified.empty())
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(pendingDue - std::chrono::steady_clock::now());
+                timeout = std::chrono::milliseconds(std::clamp<long long>(left.count(), 0, timeout.count()));
+            }
+            return timeout;
+        }
+
+        void NotifyPass(std::shared_ptr<NesesThread>& nesesth, std::chrono::milliseconds timeout)
+        {
+            events.clear();
+            if (!notifier.Wait(static_cast<int>(timeout.count()), events))
+            {
+                notifier.Close();
+                FireMessageCB("Directory notification failed for " + dirContext.dirPath.string() + ", rescanning");
+                return;
+            }
+
+            bool rescan = false;
+            for (const auto& ev : events)
+            {
                 if (nesesth->GetStopFlag())
+                    return;
+                switch (ev.type)
+                {
+                case DirEventType::created:
+                    if (ev.isDir)
+                        OnDirCreated(ev.path);
+                    else
+                        OnChanged(ev.path);
+                    break;
+                case DirEventType::modified:
+                    AddPendingModified(ev.path);
+                    break;
+                case DirEventType::closedWrite:
+                    pendingModified.erase(std::remove(pendingModified.begin(), pendingModified.end(), ev.path), pendingModified.end());
+                    OnChanged(ev.path);
+                    OnClosed(ev.path);
                     break;
+                case DirEventType::erased:
+                    if (ev.isDir)
+                        OnDirErased(ev.path);
+                    else
+                        OnErased(ev.path);
+                    break;
+                case DirEventType::overflow:
+                    rescan = true;
+                    break;
+                case DirEventType::dirGone:
+                    if (DirScanner::DepthOf(dirContext.dirPath, ev.path) == 0)
+                        notifier.Close();   // reopened and rescanned once the path is back
+                    else
+                        notifier.Remove(ev.path);
+                    break;
+                }
+            }
+
+            if (rescan && notifier.IsOpen())
+                ScanOnce(nesesth);
+            FlushPendingModified(false);
+            CheckUnsettled();
+        }
+
+        bool NotifierWanted()
+        {
+            if (watchMode == DirWatchMode::polling || !DirNotifier::IsSupported())
+                return false;
+            if (watchMode == DirWatchMode::automatic && DirNotifier::IsRemoteFileSystem(dirContext.dirPath))
+            {
+                FireMessageCB(dirContext.dirPath.string() + " is on a network file system, polling every " + std::to_string(delay.count()) + " ms");
+                return false;
+            }
+            return true;
+        }
+
+        // files still unsettled are left out, after a restart they are new and get their ready event then
+        void WriteSnapshot()
+        {
+            nextSnapshot = std::chrono::steady_clock::now() + snapshotInterval;
+            if (snapshotFile.empty() || !snapshotDirty)
+                return;
+            std::vector<FileInfo> known = files.GetQ();
+            if (!unsettled.empty())
+                known.erase(std::remove_if(known.begin(), known.end(),
+                    [this](const FileInfo& fi) { return unsettled.count(fi.hash) != 0; }), known.end());
+            BackObject back = DirSnapshot::Save(snapshotFile, dirContext.dirPath, known);
+            if (!back.Success)
+            {
+                FireMessageCB("Snapshot not written: " + back.ErrDesc);
+                return;
+            }
+            snapshotDirty = false;
+        }
+
+        // known files from the snapshot instead of the initial scan, the first scan reports the differences
+        bool LoadSnapshot()
+        {
+            if (snapshotFile.empty())
+                return false;
+            std::vector<FileInfo> known;
+            BackObject back = DirSnapshot::Load(snapshotFile, dirContext.dirPath, known);
+            if (!back.Success)
+            {
+                FireMessageCB("Snapshot not used: " + back.ErrDesc);
+                return false;
+            }
+            files.Clear();
+            for (const auto& fi : known)
+                files.AddItem(fi);
+            snapshotDirty = false;
+            return true;
+        }
+
+        void BeginWatch()
+        {
+            FireMessageCB("Directory watcher " + name + " for " + dirContext.dirPath.string() + " started");
+            useNotifier = NotifierWanted();
+            nextScan = std::chrono::steady_clock::now();
+            nextSnapshot = nextScan + snapshotInterval;
+        }
+
+        void EndWatch()
+        {
+            FlushPendingModified(true);
+            notifier.Close();
+            WriteSnapshot();
+        }
+
+        /*
+        one round of watching: events, due scan and unsettled checks. With wait it blocks until the next
+        round (own thread), without it returns at once (DirWatchService). Returns when the next round is due,
+        a notify mode watcher is also due as soon as its Handle is readable.
+        */
+        std::chrono::steady_clock::time_point Pass(std::shared_ptr<NesesThread>& nesesth, bool wait)
+        {
+            auto now = std::chrono::steady_clock::now();
+
+            /////////////////////////////////// watchpath control
+            if (!dirContext.IsValid())
+            {
+                notifier.Close();
+                FireMessageCB("Watchpath is not avaliable : " + dirContext.dirPath.string());
+                if (wait)
+                    std::this_thread::sleep_for(delay);
+                return now + delay;
+            }
+            /// ////////////////////////////////////////
+
+            if (snapshotInterval.count() > 0 && now >= nextSnapshot)
+                WriteSnapshot();
 
-                std::this_thread::sleep_for(delay);
+            if (useNotifier && !notifier.IsOpen())
+            {
+                if (notifier.Open(dirContext.dirPath))
+                {
+                    ScanOnce(nesesth);      // changes before the watch was set
+                    return now;
+                }
+                FireMessageCB("Directory notification not available for " + dirContext.dirPath.string() + ", polling");
+                useNotifier = false;
             }
 
+            if (notifier.IsOpen())
+            {
+                NotifyPass(nesesth, wait ? NotifyTimeout() : std::chrono::milliseconds(0));
+                return std::chrono::steady_clock::now() + NotifyTimeout();
+            }
+
+            // unsettled files may be due between two scans
+            if (now >= nextScan)
+            {
+                ScanOnce(nesesth);
+                nextScan = now + delay;
+            }
+            CheckUnsettled();
+
+            auto due = nextScan;
+            if (!unsettled.empty())
+                due = std::min(due, std::chrono::steady_clock::now() + NextUnsettledDue());
+            if (wait && !nesesth->GetStopFlag())
+                std::this_thread::sleep_for(std::max(std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now()), std::chrono::milliseconds(10)));
+            return due;
+        }
+
+        void WatchRoutine(std::shared_ptr<NesesThread>& nesesth)
+        {
+            BeginWatch();
+            while (nesesth->GetStopFlag() == false)
+                Pass(nesesth, true);
+            EndWatch();
             nesesth->SetIsDone(true);
 
 #ifdef _DEBUG
@@ -202,6 +608,14 @@ namespace NESES
 #endif
         }
 
+        // threadless, run by a DirWatchService
+        struct NoThread {};
+        DirWatcher(std::string aName, NoThread)
+            : name(aName)
+        {
+        }
+        friend class DirWatchService;
+
     public:
         DirWatcher()
             : DirWatcher{ "NoName" }
@@ -215,6 +629,7 @@ namespace NESES
             {
                 thHandle = res;
                 thHandle->Set(&DirWatcher::WatchRoutine, this, std::ref(thHandle));
+                thHandle->RegisterNotifierCB([this]() { notifier.Wake(); });
             }
             else
             {
@@ -234,6 +649,11 @@ namespace NESES
                 FireMessageCB("DirWatcher: Invalid directory context for " + name);
                 return;
             }
+            if (!thHandle)
+            {
+                FireMessageCB("DirWatcher: " + name + " has no thread, start its DirWatchService");
+                return;
+            }
             if (DoGetFiles() >= 0)
             {
                 thHandle->Start();
@@ -276,8 +696,63 @@ namespace NESES
                 FileModifiedCB = cb;
                 break;
             }
+            case FileStatus::ready:
+            {
+                FileReadyCB = cb;
+                break;
+            }
+            default:
+                break;
             }
         }
+        // time between two scans in polling mode, also how long writes are coalesced; before Start
+        void SetInterval(std::chrono::milliseconds interval)
+        {
+            delay = std::chrono::duration<int, std::milli>(std::max<long long>(interval.count(), 10));
+        }
+        /*
+        known files kept in file across restarts, before Start: written every interval when changed (0 only
+        at stop) and on stop, loaded on start so the changes made while stopped fire as created / modified /
+        erased. Empty file turns it off.
+        */
+        void SetSnapshot(const std::filesystem::path& file, std::chrono::milliseconds interval)
+        {
+            snapshotFile = file;
+            snapshotInterval = interval;
+        }
+        // most files kept, 0 (default) no limit
+        void SetFileCapacity(size_t capacity)
+        {
+            files.SetCapacity(capacity);
+        }
+        /*
+        stable file mode, before Start: created / modified are replaced by one ready event once a file keeps
+        its size and time for quiet (or its writer closes it, notify mode); erased only for files that were
+        ready. Polling sees changes every delay, keep quiet above it there. 0 turns it off.
+        */
+        void SetStableMode(std::chrono::milliseconds quiet)
+        {
+            quietPeriod = quiet;
+        }
+        // before Start
+        void SetWatchMode(DirWatchMode mode)
+        {
+            watchMode = mode;
+        }
+        // true while kernel notification is in use
+        bool IsEventDriven() const
+        {
+            return notifier.IsOpen();
+        }
+        // recursion, depth and include / exclude rules, before Start
+        void SetScanOptions(const DirScanOptions& options)
+        {
+            scanner.SetOptions(options);
+        }
+        const DirScanOptions& GetScanOptions() const
+        {
+            return scanner.GetOptions();
+        }
         void SetMessageCallback(CallBack<std::string>& aCB)
         {
             MessageCB = aCB;
@@ -295,12 +770,19 @@ namespace NESES
             BackObject back;
             if (dirContext.IsValid())
             {
+                if (LoadSnapshot())
+                {
+                    int known = files.GetSize();
+                    FireMessageCB(std::to_string(known) + " files loaded from snapshot for " + dirContext.dirPath.string());
+                    return known;
+                }
                 GetFiles(dirContext.dirPath.string(), back);
                 if (!back.Success)
                 {
                     FireMessageCB("Error getting initial file list: " + back.ErrDesc);
                     return -1;
                 }
+                snapshotDirty = true;       // first snapshot, or the old one was not usable
                 int fcount = files.GetSize();
                 FireMessageCB(std::to_string(fcount) + " files found on " + dirContext.dirPath.string());
                 return fcount;
@@ -0,0 +1,361 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <typeindex>
+#include <algorithm>
+#include "App.hpp"
+#include "TaskStrand.hpp"
+
+/*
+Asynchronous publish / subscribe between components.
+
+Producers (DirWatcher, TcpAsyncClient, Logger callbacks, ...) publish into a typed topic and return
+immediately; every subscriber has its own bounded queue which is drained on the task pool, so a slow
+handler only ever delays itself.
+
+	auto topic = EventBus::Instance().Topic<FileInfo>("files.created");
+	topic->Subscribe([](const FileInfo& fi) { ... });
+	createdCb.setCallback(topic->Publisher());		// bridge an existing CallBack
+	watcher.SetFileCB(createdCb, FileStatus::created);
+*/
+
+namespace NESES
+{
+	// what a full subscriber queue does with a new event, the producer is never blocked
+	enum class EventOverflowPolicy
+	{
+		dropNewest,		// keep the queue, discard the incoming event
+		dropOldest		// discard the oldest queued event, keep the incoming one
+	};
+
+	struct EventSubscriptionOptions
+	{
+		size_t capacity{ 1024 };										// per subscriber queue bound
+		EventOverflowPolicy policy{ EventOverflowPolicy::dropOldest };
+		size_t maxBatch{ 64 };											// events handed to a batch handler at once
+		std::string lane{ Lane::cpu };									// executor the handler runs on
+		std::shared_ptr<TaskStrand<BackObject>> strand{ nullptr };		// optional, share ordering with other work
+	};
+
+	template <typename T>
+	class EventTopic;
+
+	template <typename T>
+	class EventSubscription : public std::enable_shared_from_this<EventSubscription<T>>
+	{
+	private:
+		static constexpr size_t maxTurns = 16;		// batches per pool turn before yielding
+
+		std::string name_;
+		EventSubscriptionOptions options_;
+		std::function<void(const T&)> handler_;
+		std::function<void(const std::vector<T>&)> batchHandler_;
+		std::shared_ptr<TaskStrand<BackObject>> strand_;
+
+		std::deque<T> queue_;
+		std::mutex queueLock;
+		bool scheduled_{ false };
+		std::atomic<bool> active_{ true };
+		std::atomic<uint64_t> delivered_{ 0 };
+		std::atomic<uint64_t> dropped_{ 0 };
+
+		EventSubscription(const std::string& name, const EventSubscriptionOptions& options)
+			: name_(name), options_(options)
+		{
+			if (options_.capacity == 0) options_.capacity = 1;
+			if (options_.maxBatch == 0) options_.maxBatch = 1;
+			strand_ = options_.strand ? options_.strand : App::Instance().NewStrand("event-" + name_, options_.lane);
+		}
+
+		bool Schedule()
+		{
+			if (!strand_) return false;
+			auto self = this->shared_from_this();
+			return strand_->Post("event-" + name_, [self]() { self->Drain(); return BackObject(); }) != nullptr;
+		}
+
+		// a drain task was refused: a full strand queue is retried by the next Push, a stopped strand
+		// (pool stopping) runs nothing any more and the subscription ends, false then
+		bool ScheduleFailed()
+		{
+			{
+				std::lock_guard<std::mutex> lock(queueLock);
+				scheduled_ = false;
+			}
+			if (strand_ && !strand_->IsStopped())
+				return true;
+			std::cerr << "Event subscription " << name_ << " ended, its strand is stopped" << std::endl;
+			Cancel();
+			return false;
+		}
+
+		// runs on the strand, never concurrently with itself
+		void Drain()
+		{
+			std::vector<T> batch;
+			batch.reserve(options_.maxBatch);
+
+			for (size_t turn = 0; turn < maxTurns; turn++)
+			{
+				{
+					std::lock_guard<std::mutex> lock(queueLock);
+					if (queue_.empty() || !active_.load())
+					{
+						scheduled_ = false;
+						return;
+					}
+					size_t n = batchHandler_ ? std::min(options_.maxBatch, queue_.size()) : 1;
+					for (size_t i = 0; i < n; i++)
+					{
+						batch.push_back(std::move(queue_.front()));
+						queue_.pop_front();
+					}
+				}
+
+				try
+				{
+					if (batchHandler_)
+						batchHandler_(batch);
+					else
+						handler_(batch.front());
+				}
+				catch (const std::exception& ex)
+				{
+					std::cerr << "Event handler error on " << name_ << " : " << ex.what() << std::endl;
+				}
+				catch (...)
+				{
+					std::cerr << "Unknown event handler error on " << name_ << std::endl;
+				}
+				delivered_ += batch.size();
+				batch.clear();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(queueLock);
+				if (queue_.empty() || !active_.load())
+				{
+					scheduled_ = false;
+					return;
+				}
+			}
+
+			// yield the worker, continue in a new task
+			if (!Schedule())
+				ScheduleFailed();
+		}
+
+		// producer side, never waits for the handler
+		bool Push(const T& ev)
+		{
+			if (!active_.load()) return false;
+
+			bool accepted = true;
+			bool schedule = false;
+			{
+				std::lock_guard<std::mutex> lock(queueLock);
+				if (queue_.size() >= options_.capacity)
+				{
+					dropped_++;
+					if (options_.policy == EventOverflowPolicy::dropNewest)
+						accepted = false;
+					else
+						queue_.pop_front();
+				}
+				if (accepted)
+					queue_.push_back(ev);
+				if (!scheduled_ && !queue_.empty())
+				{
+					scheduled_ = true;
+					schedule = true;
+				}
+			}
+
+			if (schedule && !Schedule() && !ScheduleFailed())
+				return false;		// counted in dropped by Cancel
+			return accepted;
+		}
+
+	public:
+		EventSubscription(const EventSubscription&) = delete;
+		EventSubscription& operator=(const EventSubscription&) = delete;
+
+		// stop delivering, queued events are discarded
+		void Cancel()
+		{
+			active_.store(false);
+			std::lock_guard<std::mutex> lock(queueLock);
+			dropped_ += queue_.size();
+			queue_.clear();
+		}
+
+		bool IsActive() const { return active_.load(); }
+		uint64_t Delivered() const { return delivered_.load(); }
+		uint64_t Dropped() const { return dropped_.load(); }
+
+		size_t Pending()
+		{
+			std::lock_guard<std::mutex> lock(queueLock);
+			return queue_.size();
+		}
+
+		friend class EventTopic<T>;
+	};
+
+	template <typename T>
+	class EventTopic : public std::enable_shared_from_this<EventTopic<T>>
+	{
+	private:
+		using SubscriptionList = std::vector<std::shared_ptr<EventSubscription<T>>>;
+
+		std::string name_;
+		std::shared_ptr<const SubscriptionList> subscriptions_;		// copy-on-write, read lock-free by Publish
+		std::mutex writeLock;										// serializes Subscribe / Unsubscribe
+
+		EventTopic(const std::string& name) : name_(name) {}
+
+		std::shared_ptr<EventSubscription<T>> Add(std::shared_ptr<EventSubscription<T>> sub)
+		{
+			std::lock_guard<std::mutex> lock(writeLock);
+			auto current = std::atomic_load(&subscriptions_);
+			auto next = current ? std::make_shared<SubscriptionList>(*current) : std::make_shared<SubscriptionList>();
+			next->push_back(sub);
+			std::atomic_store(&subscriptions_, std::shared_ptr<const SubscriptionList>(std::move(next)));
+			return sub;
+		}
+
+	public:
+		EventTopic(const EventTopic&) = delete;
+		EventTopic& operator=(const EventTopic&) = delete;
+
+		const std::string& GetName() const { return name_; }
+
+		std::shared_ptr<EventSubscription<T>> Subscribe(std::function<void(const T&)> handler,
+			const EventSubscriptionOptions& options = EventSubscriptionOptions())
+		{
+			if (!handler) return nullptr;
+			auto sub = std::shared_ptr<EventSubscription<T>>(new EventSubscription<T>(name_, options));
+			sub->handler_ = std::move(handler);
+			return Add(sub);
+		}
+
+		// batched delivery: the handler gets up to options.maxBatch queued events per call
+		std::shared_ptr<EventSubscription<T>> SubscribeBatch(std::function<void(const std::vector<T>&)> handler,
+			const EventSubscriptionOptions& options = EventSubscriptionOptions())
+		{
+			if (!handler) return nullptr;
+			auto sub = std::shared_ptr<EventSubscription<T>>(new EventSubscription<T>(name_, options));
+			sub->batchHandler_ = std::move(handler);
+			return Add(sub);
+		}
+
+		bool Unsubscribe(const std::shared_ptr<EventSubscription<T>>& sub)
+		{
+			if (!sub) return false;
+			sub->Cancel();
+			std::lock_guard<std::mutex> lock(writeLock);
+			auto current = std::atomic_load(&subscriptions_);
+			if (!current) return false;
+			auto next = std::make_shared<SubscriptionList>(*current);
+			auto it = std::find(next->begin(), next->end(), sub);
+			if (it == next->end()) return false;
+			next->erase(it);
+			std::atomic_store(&subscriptions_, std::shared_ptr<const SubscriptionList>(std::move(next)));
+			return true;
+		}
+
+		// returns the number of subscribers that accepted the event
+		size_t Publish(const T& ev)
+		{
+			auto subs = std::atomic_load(&subscriptions_);
+			if (!subs) return 0;
+			size_t back = 0;
+			for (const auto& sub : *subs)
+			{
+				if (sub->Push(ev))
+					back++;
+			}
+			return back;
+		}
+
+		size_t SubscriberCount() const
+		{
+			auto subs = std::atomic_load(&subscriptions_);
+			return subs ? subs->size() : 0;
+		}
+
+		// adapter for CallBack<T> / CallBack<const T&> producers
+		std::function<void(const T&)> Publisher()
+		{
+			auto self = this->shared_from_this();
+			return [self](const T& ev) { self->Publish(ev); };
+		}
+
+		friend class EventBus;
+	};
+
+	class EventBus
+	{
+	private:
+		struct TopicEntry
+		{
+			std::type_index type;
+			std::shared_ptr<void> topic;
+		};
+
+		std::map<std::string, TopicEntry> topics;
+		std::mutex busLock;
+
+		EventBus() = default;
+
+	public:
+		EventBus(const EventBus&) = delete;
+		EventBus& operator=(const EventBus&) = delete;
+
+		static EventBus& Instance()
+		{
+			static EventBus instance;
+			return instance;
+		}
+
+		// get or create the topic, nullptr if the name is already used with another event type
+		template <typename T>
+		std::shared_ptr<EventTopic<T>> Topic(const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(busLock);
+			auto it = topics.find(name);
+			if (it != topics.end())
+			{
+				if (it->second.type != std::type_index(typeid(T)))
+				{
+					std::cerr << "EventBus topic " << name << " already exists with another event type" << std::endl;
+					return nullptr;
+				}
+				return std::static_pointer_cast<EventTopic<T>>(it->second.topic);
+			}
+			auto topic = std::shared_ptr<EventTopic<T>>(new EventTopic<T>(name));
+			topics.emplace(name, TopicEntry{ std::type_index(typeid(T)), topic });
+			return topic;
+		}
+
+		template <typename T>
+		size_t Publish(const std::string& name, const T& ev)
+		{
+			auto topic = Topic<T>(name);
+			return topic ? topic->Publish(ev) : 0;
+		}
+
+		bool RemoveTopic(const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(busLock);
+			return topics.erase(name) > 0;
+		}
+	};
+}
@@ -1,114 +1,264 @@
 #pragma once
 #include <mutex>
-#include <list>
-#include <optional>
+#include <vector>
+#include <cstdint>
 #include "FileInfo.hpp"
 #include "BackObject.hpp"
 
+/*
+Known files of a watcher, items in a dense vector and an open addressing (linear probing) index on the path
+hash, lookups do not depend on the file count. A removed item is replaced by the last one, pointers
+returned by the lookups are valid until the next AddItem / RemoveItem.
+
+Deletions are found by mark and sweep instead of probing every path:
+
+	files.BeginScan();
+	for (each entry) files.Visit(fi) ... or AddItem(fi);
+	files.Sweep([](FileInfo& fi) { ... });		// the ones not visited since BeginScan
+*/
+
 namespace NESES
 {
 	class FileList
 	{
 	private:
-		std::list<FileInfo> q;
+		struct Slot
+		{
+			size_t hash{ 0 };
+			uint32_t pos{ 0 };		// item index + 1, 0 empty
+		};
+
+		std::vector<FileInfo> q;
+		std::vector<uint32_t> seen;			// scan generation an item was last visited in, parallel to q
+		std::vector<Slot> index;			// power of two size
+		uint32_t generation{ 0 };
+		size_t BufCapacity{ 0 };			// 0 no limit
 		std::mutex mtx;
-		size_t BufCapacity{ 10000 };
+
+		size_t Home(size_t hash) const
+		{
+			// the path hash is not well mixed in the low bits on every library
+			uint64_t h = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+			return static_cast<size_t>(h >> 32) & (index.size() - 1);
+		}
+
+		// slot of hash, or the empty slot it would go to
+		size_t Probe(size_t hash) const
+		{
+			size_t mask = index.size() - 1;
+			size_t i = Home(hash);
+			while (index[i].pos != 0 && index[i].hash != hash)
+				i = (i + 1) & mask;
+			return i;
+		}
+
+		void Rehash(size_t slots)
+		{
+			index.assign(slots, Slot());
+			for (size_t i = 0; i < q.size(); i++)
+			{
+				size_t s = Probe(q[i].hash);
+				index[s].hash = q[i].hash;
+				index[s].pos = static_cast<uint32_t>(i + 1);
+			}
+		}
+
+		// load factor kept under 0.7
+		void Reserve(size_t count)
+		{
+			size_t slots = index.empty() ? 64 : index.size();
+			while (count * 10 >= slots * 7)
+				slots *= 2;
+			if (slots != index.size())
+				Rehash(slots);
+		}
+
+		// backward shift, no tombstones left behind
+		void EraseSlot(size_t i)
+		{
+			size_t mask = index.size() - 1;
+			size_t j = i;
+			while (true)
+			{
+				j = (j + 1) & mask;
+				if (index[j].pos == 0)
+					break;
+				size_t k = Home(index[j].hash);
+				bool movable = (i <= j) ? (k <= i || k > j) : (k <= i && k > j);
+				if (movable)
+				{
+					index[i] = index[j];
+					i = j;
+				}
+			}
+			index[i] = Slot();
+		}
+
+		FileInfo* FindLocked(size_t hash)
+		{
+			if (hash == 0 || index.empty()) return nullptr;
+			size_t s = Probe(hash);
+			if (index[s].pos == 0) return nullptr;
+			FileInfo* item = &q[index[s].pos - 1];
+			return item->IsDeleted ? nullptr : item;
+		}
+
+		// the last item takes the place of pos
+		void RemoveAtLocked(size_t pos)
+		{
+			EraseSlot(Probe(q[pos].hash));
+			size_t last = q.size() - 1;
+			if (pos != last)
+			{
+				q[pos] = q[last];		// FileInfo has no usable move assignment (NesesDateTime pimpl)
+				seen[pos] = seen[last];
+				index[Probe(q[pos].hash)].pos = static_cast<uint32_t>(pos + 1);
+			}
+			q.pop_back();
+			seen.pop_back();
+		}
 
 	public:
 
+		// 0 removes the limit, items over it are not removed
+		void SetCapacity(size_t capacity)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			BufCapacity = capacity;
+		}
+
 		BackObject AddItem(const FileInfo& anItem)
 		{
 			BackObject back;
-			if (q.size() < BufCapacity && !Contains(anItem))
+			std::lock_guard<std::mutex> lock(mtx);
+			if (anItem.hash == 0 || (BufCapacity != 0 && q.size() >= BufCapacity))
+			{
+				back.ErrDesc = "Invalid item or buffer limit reached";
+				back.Success = false;
+				return back;
+			}
+			Reserve(q.size() + 1);
+			size_t s = Probe(anItem.hash);
+			if (index[s].pos != 0 && q[index[s].pos - 1].IsDeleted)
 			{
-				std::unique_lock<std::mutex> lock(mtx);
-				q.push_back(anItem);
-				lock.unlock();
+				q[index[s].pos - 1] = anItem;		// flagged, not removed yet
+				seen[index[s].pos - 1] = generation;
 				back.Success = true;
+				return back;
 			}
-			else
+			if (index[s].pos != 0)
 			{
-				back.ErrDesc = "Already exists or buffer limit reached";
+				back.ErrDesc = "Already exists";
 				back.Success = false;
+				return back;
 			}
+			q.push_back(anItem);
+			seen.push_back(generation);
+			index[s].hash = anItem.hash;
+			index[s].pos = static_cast<uint32_t>(q.size());
+			back.Success = true;
 			return back;
 		}
 
 		bool Contains(const FileInfo& anItem)
 		{
-			if (anItem.hash == 0) return false;
-			std::unique_lock<std::mutex> lock(mtx);
-			auto it = std::find_if(q.begin(), q.end(), [&](const FileInfo& item) {return  (item.IsDeleted == false) && (item.hash == anItem.hash); });
-			if (it == q.end())
-				return false;
-			else
-				return true;
+			std::lock_guard<std::mutex> lock(mtx);
+			return FindLocked(anItem.hash) != nullptr;
 		}
 
 		bool RemoveItem(const FileInfo& anItem)
 		{
 			if (anItem.hash == 0) return false;
-			std::unique_lock<std::mutex> lock(mtx);
-			auto it = std::find_if(q.begin(), q.end(), [&](const FileInfo& item) {return item.hash == anItem.hash; });
-			if (it != q.end())
-			{
-				q.erase(it);
-				return true;
-			}
-			return false;
+			std::lock_guard<std::mutex> lock(mtx);
+			if (index.empty()) return false;
+			size_t s = Probe(anItem.hash);
+			if (index[s].pos == 0) return false;
+			RemoveAtLocked(index[s].pos - 1);
+			return true;
 		}
 
 		void RemoveDeleted()
 		{
-			std::unique_lock<std::mutex> lock(mtx);
-			q.remove_if([=](FileInfo a) {return a.IsDeleted == true; });
-			lock.unlock();
+			std::lock_guard<std::mutex> lock(mtx);
+			for (size_t i = q.size(); i-- > 0; )
+			{
+				if (q[i].IsDeleted)
+					RemoveAtLocked(i);
+			}
 		}
 
-		std::list<FileInfo>::iterator Begin()
+		std::vector<FileInfo>::iterator Begin()
 		{
 			return q.begin();
 		}
 
-		std::list<FileInfo>::iterator End()
+		std::vector<FileInfo>::iterator End()
 		{
 			return q.end();
 		}
 
-		const std::list<FileInfo> GetQ()
+		const std::vector<FileInfo> GetQ()
 		{
+			std::lock_guard<std::mutex> lock(mtx);
 			return q;
 		}
 
-		FileInfo& Front()
+		FileInfo* GetIfContains(const FileInfo& anItem)
 		{
-			return q.front();
+			std::lock_guard<std::mutex> lock(mtx);
+			return FindLocked(anItem.hash);
 		}
 
-		void PopFront()
+		// new scan, every item counts as gone until visited
+		void BeginScan()
 		{
-			q.pop_front();
+			std::lock_guard<std::mutex> lock(mtx);
+			generation++;
 		}
 
-		FileInfo* GetIfContains(const FileInfo& anItem)
+		// GetIfContains that also marks the item as seen in this scan
+		FileInfo* Visit(const FileInfo& anItem)
 		{
-			if (anItem.hash == 0)  return nullptr;
-			auto it = std::find_if(q.begin(), q.end(), [&](const FileInfo& item) {return (item.IsDeleted == false) && (item.hash == anItem.hash); });
-			if (it == q.end())
-				return nullptr;
-			else
-				return &(*it);
+			std::lock_guard<std::mutex> lock(mtx);
+			FileInfo* item = FindLocked(anItem.hash);
+			if (item)
+				seen[static_cast<size_t>(item - q.data())] = generation;
+			return item;
 		}
 
+		// removes the items not visited or added since BeginScan, onGone gets each one after removal
+		template <typename F>
+		size_t Sweep(F&& onGone)
+		{
+			std::vector<FileInfo> gone;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				for (size_t i = q.size(); i-- > 0; )
+				{
+					if (seen[i] != generation)
+					{
+						gone.push_back(q[i]);
+						RemoveAtLocked(i);
+					}
+				}
+			}
+			for (auto& fi : gone)
+				onGone(fi);
+			return gone.size();
+		}
 
 		int GetSize()
 		{
+			std::lock_guard<std::mutex> lock(mtx);
 			return static_cast<int>(q.size());
 		}
 
 		void Clear()
 		{
+			std::lock_guard<std::mutex> lock(mtx);
 			q.clear();
+			seen.clear();
+			index.clear();
 		}
 	};
 
@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+namespace NESES
+{
+// std::function replacement that never allocates: the callable is stored in a fixed
+// inline buffer and a callable that does not fit is a compile error, not a heap block.
+// Used for callback subscribers that are copied around (copy-on-write lists).
+template <typename Signature, std::size_t Capacity = 64>
+class InlineFunction;
+
+template <typename R, typename... Args, std::size_t Capacity>
+class InlineFunction<R(Args...), Capacity>
+{
+private:
+    // per callable type operations, one static table per instantiation
+    struct Ops
+    {
+        R(*invoke)(void*, Args&&...);
+        void (*copy)(void* dst, const void* src);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template <typename Fn>
+    static const Ops* opsFor()
+    {
+        static const Ops ops{
+            [](void* p, Args&&... args) -> R { return (*static_cast<Fn*>(p))(std::forward<Args>(args)...); },
+            [](void* dst, const void* src) { ::new (dst) Fn(*static_cast<const Fn*>(src)); },
+            [](void* dst, void* src) noexcept { ::new (dst) Fn(std::move(*static_cast<Fn*>(src))); static_cast<Fn*>(src)->~Fn(); },
+            [](void* p) noexcept { static_cast<Fn*>(p)->~Fn(); }
+        };
+        return &ops;
+    }
+
+    // empty std::function / null function pointers stay empty instead of throwing on call
+    template <typename Fn>
+    static bool isEmpty(const Fn&) { return false; }
+    template <typename Sig>
+    static bool isEmpty(const std::function<Sig>& f) { return !f; }
+    template <typename Ret, typename... FArgs>
+    static bool isEmpty(Ret(* const& f)(FArgs...)) { return f == nullptr; }
+
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+    const Ops* ops_{ nullptr };
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+public:
+    InlineFunction() noexcept = default;
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InlineFunction>>>
+    InlineFunction(F&& f)
+    {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Capacity, "callable does not fit into InlineFunction, reduce the captures or raise Capacity");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "over-aligned callable");
+        static_assert(std::is_copy_constructible_v<Fn>, "callable must be copy constructible");
+        static_assert(std::is_invocable_r_v<R, Fn&, Args...>, "callable signature mismatch");
+
+        if (isEmpty(f)) return;
+        ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+        ops_ = opsFor<Fn>();
+    }
+
+    InlineFunction(const InlineFunction& other)
+    {
+        if (other.ops_)
+        {
+            other.ops_->copy(storage_, other.storage_);
+            ops_ = other.ops_;
+        }
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept
+    {
+        if (other.ops_)
+        {
+            other.ops_->move(storage_, other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    InlineFunction& operator=(const InlineFunction& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                other.ops_->copy(storage_, other.storage_);
+                ops_ = other.ops_;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    ~InlineFunction()
+    {
+        reset();
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return ops_ != nullptr;
+    }
+
+    // calling an empty InlineFunction is a no-op for void and returns R{} otherwise
+    R operator()(Args... args) const
+    {
+        if (!ops_)
+        {
+            if constexpr (std::is_void_v<R>)
+                return;
+            else
+                return R{};
+        }
+        return ops_->invoke(const_cast<unsigned char*>(storage_), std::forward<Args>(args)...);
+    }
+};
+} // namespace NESES
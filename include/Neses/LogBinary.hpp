@@ -0,0 +1,440 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+#include <istream>
+#include <cstdint>
+#include <cstring>
+#include "LogRecord.hpp"
+
+/*
+Binary log encoding, the compact alternative of the text log file (Logger::UseBinaryFile).
+
+The logger thread does not format anything: format strings, file and function names are written once
+per file and referred to by id, timestamps are varint deltas and the arguments keep their LogRecord
+types. NESESLOGDEC renders the files back to the text layout.
+
+	file      : "NESLOGB1" then entries, each starts with its kind byte
+	sync      : string / callsite tables and the time base are reset, every writer session starts with one
+	string    : [id][length][bytes]
+	callsite  : [id][format id][file id][func id][tag id][line][withLocation u8]
+	record    : [type u8][flags u8][zigzag ns delta][callsite id], then
+	            no callsite     : [file id][func id][zigzag line][length][text]
+	            text callsite   : [length][text]
+	            format callsite : [arg count] and per argument [LogArgType u8][value]
+	values    : i64 zigzag varint, u64 / ptr varint, f64 8 bytes, boolean / character 1 byte, str [length][bytes]
+
+Numbers are LEB128 varints, string id 0 is nullptr. Strings are interned by address, they are static
+(__FILE__, __func__, format literals) as LogRecord already requires.
+*/
+
+namespace NESES
+{
+	constexpr char LogBinaryMagic[8] = { 'N', 'E', 'S', 'L', 'O', 'G', 'B', '1' };
+
+	enum class LogBinaryKind : uint8_t
+	{
+		sync = 1,
+		string = 2,
+		callsite = 3,
+		record = 4
+	};
+
+	inline uint64_t LogZigZag(int64_t v)
+	{
+		return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+	}
+
+	inline int64_t LogUnZigZag(uint64_t v)
+	{
+		return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+	}
+
+	// logger thread only, one instance per output file
+	class LogBinaryEncoder
+	{
+	private:
+		std::unordered_map<const char*, uint32_t> strings_;
+		std::unordered_map<const LogCallsite*, uint32_t> callsites_;
+		int64_t lastTs_{ 0 };
+
+		static void PutVarint(std::string& out, uint64_t v)
+		{
+			while (v >= 0x80)
+			{
+				out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+				v >>= 7;
+			}
+			out.push_back(static_cast<char>(v));
+		}
+
+		static void PutKind(std::string& out, LogBinaryKind kind)
+		{
+			out.push_back(static_cast<char>(kind));
+		}
+
+		uint32_t StringId(const char* s, std::string& out)
+		{
+			if (!s) return 0;
+			auto it = strings_.find(s);
+			if (it != strings_.end()) return it->second;
+
+			uint32_t id = static_cast<uint32_t>(strings_.size() + 1);
+			strings_.emplace(s, id);
+			size_t len = std::strlen(s);
+			PutKind(out, LogBinaryKind::string);
+			PutVarint(out, id);
+			PutVarint(out, len);
+			out.append(s, len);
+			return id;
+		}
+
+		uint32_t CallsiteId(const LogCallsite& cs, std::string& out)
+		{
+			auto it = callsites_.find(&cs);
+			if (it != callsites_.end()) return it->second;
+
+			uint32_t formatId = StringId(cs.format, out);
+			uint32_t fileId = StringId(cs.file, out);
+			uint32_t funcId = StringId(cs.func, out);
+			uint32_t tagId = StringId(cs.tag, out);
+			uint32_t id = static_cast<uint32_t>(callsites_.size() + 1);
+			callsites_.emplace(&cs, id);
+			PutKind(out, LogBinaryKind::callsite);
+			PutVarint(out, id);
+			PutVarint(out, formatId);
+			PutVarint(out, fileId);
+			PutVarint(out, funcId);
+			PutVarint(out, tagId);
+			PutVarint(out, static_cast<uint64_t>(cs.line < 0 ? 0 : cs.line));
+			out.push_back(cs.withLocation ? 1 : 0);
+			return id;
+		}
+
+		// record payload to the file form, false on an unknown argument type
+		static bool PutArgs(const LogRecord& rec, std::string& out)
+		{
+			PutVarint(out, rec.argCount);
+			size_t pos = 0;
+			while (pos < rec.size)
+			{
+				const char* p = rec.payload + pos;
+				LogArgType at = static_cast<LogArgType>(*p++);
+				out.push_back(static_cast<char>(at));
+				switch (at)
+				{
+				case LogArgType::i64:
+				{
+					int64_t v;
+					std::memcpy(&v, p, sizeof(v));
+					PutVarint(out, LogZigZag(v));
+					pos += 1 + sizeof(v);
+					break;
+				}
+				case LogArgType::u64:
+				case LogArgType::ptr:
+				{
+					uint64_t v;
+					std::memcpy(&v, p, sizeof(v));
+					PutVarint(out, v);
+					pos += 1 + sizeof(v);
+					break;
+				}
+				case LogArgType::f64:
+					out.append(p, sizeof(double));
+					pos += 1 + sizeof(double);
+					break;
+				case LogArgType::boolean:
+				case LogArgType::character:
+					out.push_back(*p);
+					pos += 2;
+					break;
+				case LogArgType::str:
+				{
+					uint16_t len;
+					std::memcpy(&len, p, sizeof(len));
+					PutVarint(out, len);
+					out.append(p + sizeof(len), len);
+					pos += 1 + sizeof(len) + len;
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return true;
+		}
+
+	public:
+		// start of a writer session, the file header goes first into an empty file
+		void Begin(std::string& out, bool emptyFile)
+		{
+			if (emptyFile)
+				out.append(LogBinaryMagic, sizeof(LogBinaryMagic));
+			PutKind(out, LogBinaryKind::sync);
+			strings_.clear();
+			callsites_.clear();
+			lastTs_ = 0;
+		}
+
+		// appends the record, with the string / callsite definitions it needs first
+		void Encode(const LogRecord& rec, std::string& out)
+		{
+			uint32_t csId = rec.callsite ? CallsiteId(*rec.callsite, out) : 0;
+			uint32_t fileId = rec.callsite ? 0 : StringId(rec.file, out);
+			uint32_t funcId = rec.callsite ? 0 : StringId(rec.func, out);
+
+			size_t head = out.size();
+			PutKind(out, LogBinaryKind::record);
+			out.push_back(static_cast<char>(rec.type));
+			out.push_back(static_cast<char>(rec.flags));
+			PutVarint(out, LogZigZag(rec.timestamp - lastTs_));
+			PutVarint(out, csId);
+			if (!rec.callsite)
+			{
+				PutVarint(out, fileId);
+				PutVarint(out, funcId);
+				PutVarint(out, LogZigZag(rec.line));
+			}
+
+			if (!rec.callsite || !rec.callsite->format)
+			{
+				std::string_view text = rec.Text();
+				PutVarint(out, text.size());
+				out.append(text.data(), text.size());
+			}
+			else if (!PutArgs(rec, out))
+			{
+				out.resize(head);		// corrupt payload, the definitions stay
+				return;
+			}
+			lastTs_ = rec.timestamp;
+		}
+	};
+
+	// reads a binary log stream, records are rebuilt as LogRecords so the text rendering is the Logger's
+	class LogBinaryReader
+	{
+	private:
+		std::streambuf* in_;
+		std::unordered_map<uint32_t, std::string> strings_;
+		std::unordered_map<uint32_t, std::unique_ptr<LogCallsite>> callsites_;
+		std::string scratch_;
+		int64_t lastTs_{ 0 };
+		bool error_{ false };
+
+		bool GetByte(uint8_t& b)
+		{
+			int c = in_->sbumpc();
+			if (c == std::char_traits<char>::eof()) return false;
+			b = static_cast<uint8_t>(c);
+			return true;
+		}
+
+		bool GetVarint(uint64_t& v)
+		{
+			v = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				uint8_t b;
+				if (!GetByte(b)) return false;
+				v |= static_cast<uint64_t>(b & 0x7F) << shift;
+				if (!(b & 0x80)) return true;
+			}
+			return false;
+		}
+
+		bool GetBytes(std::string& out, uint64_t len)
+		{
+			if (len > (1u << 30)) return false;
+			out.resize(static_cast<size_t>(len));
+			return len == 0 || in_->sgetn(&out[0], static_cast<std::streamsize>(len)) == static_cast<std::streamsize>(len);
+		}
+
+		bool String(uint64_t id, const char*& out) const
+		{
+			if (id == 0)
+			{
+				out = nullptr;
+				return true;
+			}
+			auto it = strings_.find(static_cast<uint32_t>(id));
+			if (it == strings_.end()) return false;
+			out = it->second.c_str();
+			return true;
+		}
+
+		bool ReadString()
+		{
+			uint64_t id, len;
+			if (!GetVarint(id) || !GetVarint(len) || !GetBytes(scratch_, len)) return false;
+			strings_[static_cast<uint32_t>(id)] = scratch_;
+			return true;
+		}
+
+		bool ReadCallsite()
+		{
+			uint64_t id, formatId, fileId, funcId, tagId, line;
+			uint8_t withLocation;
+			if (!GetVarint(id) || !GetVarint(formatId) || !GetVarint(fileId) || !GetVarint(funcId)
+				|| !GetVarint(tagId) || !GetVarint(line) || !GetByte(withLocation))
+				return false;
+			auto cs = std::make_unique<LogCallsite>();
+			if (!String(formatId, cs->format) || !String(fileId, cs->file) || !String(funcId, cs->func) || !String(tagId, cs->tag))
+				return false;
+			cs->line = static_cast<int>(line);
+			cs->withLocation = withLocation != 0;
+			callsites_[static_cast<uint32_t>(id)] = std::move(cs);
+			return true;
+		}
+
+		bool ReadArgs(LogRecord& rec)
+		{
+			uint64_t count;
+			if (!GetVarint(count)) return false;
+			for (uint64_t i = 0; i < count; i++)
+			{
+				uint8_t at;
+				if (!GetByte(at)) return false;
+				switch (static_cast<LogArgType>(at))
+				{
+				case LogArgType::i64:
+				{
+					uint64_t v;
+					if (!GetVarint(v)) return false;
+					rec.Append(LogUnZigZag(v));
+					break;
+				}
+				case LogArgType::u64:
+				{
+					uint64_t v;
+					if (!GetVarint(v)) return false;
+					rec.Append(v);
+					break;
+				}
+				case LogArgType::ptr:
+				{
+					uint64_t v;
+					if (!GetVarint(v)) return false;
+					rec.Append(reinterpret_cast<const void*>(static_cast<uintptr_t>(v)));
+					break;
+				}
+				case LogArgType::f64:
+				{
+					double v;
+					if (in_->sgetn(reinterpret_cast<char*>(&v), sizeof(v)) != static_cast<std::streamsize>(sizeof(v))) return false;
+					rec.Append(v);
+					break;
+				}
+				case LogArgType::boolean:
+				{
+					uint8_t v;
+					if (!GetByte(v)) return false;
+					rec.Append(v != 0);
+					break;
+				}
+				case LogArgType::character:
+				{
+					uint8_t v;
+					if (!GetByte(v)) return false;
+					rec.Append(static_cast<char>(v));
+					break;
+				}
+				case LogArgType::str:
+				{
+					uint64_t len;
+					if (!GetVarint(len) || !GetBytes(scratch_, len)) return false;
+					rec.Append(std::string_view(scratch_));
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool ReadRecord(LogRecord& rec)
+		{
+			uint8_t type, flags;
+			uint64_t delta, csId;
+			if (!GetByte(type) || !GetByte(flags) || !GetVarint(delta) || !GetVarint(csId)) return false;
+			lastTs_ += LogUnZigZag(delta);
+			rec.Reset(static_cast<LogType>(type), lastTs_);
+
+			if (csId == 0)
+			{
+				uint64_t fileId, funcId, line;
+				if (!GetVarint(fileId) || !GetVarint(funcId) || !GetVarint(line)) return false;
+				if (!String(fileId, rec.file) || !String(funcId, rec.func)) return false;
+				rec.line = static_cast<int32_t>(LogUnZigZag(line));
+			}
+			else
+			{
+				auto it = callsites_.find(static_cast<uint32_t>(csId));
+				if (it == callsites_.end()) return false;
+				rec.callsite = it->second.get();
+			}
+
+			if (!rec.callsite || !rec.callsite->format)
+			{
+				uint64_t len;
+				if (!GetVarint(len) || !GetBytes(scratch_, len)) return false;
+				rec.SetText(scratch_.data(), scratch_.size());
+			}
+			else if (!ReadArgs(rec))
+			{
+				return false;
+			}
+			rec.flags = flags;
+			return true;
+		}
+
+	public:
+		explicit LogBinaryReader(std::istream& in)
+			: in_(in.rdbuf())
+		{
+			char magic[sizeof(LogBinaryMagic)];
+			error_ = !in_ || in_->sgetn(magic, sizeof(magic)) != static_cast<std::streamsize>(sizeof(magic))
+				|| std::memcmp(magic, LogBinaryMagic, sizeof(magic)) != 0;
+		}
+
+		// true if the stream is not a binary log or ended inside an entry
+		bool Error() const { return error_; }
+
+		// next record, false at the end of the stream or on an error
+		// strings of rec point into the reader and stay valid until the next call, call rec.Release() when done
+		bool Next(LogRecord& rec)
+		{
+			while (!error_)
+			{
+				uint8_t kind;
+				if (!GetByte(kind)) return false;
+				switch (static_cast<LogBinaryKind>(kind))
+				{
+				case LogBinaryKind::sync:
+					strings_.clear();
+					callsites_.clear();
+					lastTs_ = 0;
+					break;
+				case LogBinaryKind::string:
+					error_ = !ReadString();
+					break;
+				case LogBinaryKind::callsite:
+					error_ = !ReadCallsite();
+					break;
+				case LogBinaryKind::record:
+					if (ReadRecord(rec)) return true;
+					rec.Release();
+					error_ = true;
+					break;
+				default:
+					error_ = true;
+					break;
+				}
+			}
+			return false;
+		}
+	};
+}
@@ -0,0 +1,256 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include "Exporter.h"
+#include "LogFileSink.hpp"
+
+/*
+Memory mapped log file, for the highest volume services.
+
+Each segment is a preallocated file (fallocate, no sparse fallback) mapped into memory, a line costs a memcpy and an atomic
+offset bump, the kernel writes the pages back. msync(MS_ASYNC) is issued by the logger thread following
+the flush policy. A full segment is cut to its used size and the next one is opened:
+	<path><date>.txt, <path><date>.1.txt, <path><date>.2.txt ...
+Closed segments go to the LogRotator (compression, retention) when one is set.
+Writer is the logger thread, the committed offset can be read from any thread.
+The file and mapping calls are in LogMmapSink.cpp, clients of Logger.hpp do not get windows.h.
+*/
+
+namespace NESES
+{
+	// one mapped segment file, handles as the platform has them (HANDLE or fd)
+	struct LogMappedFile
+	{
+		void* file{ nullptr };
+		void* mapping{ nullptr };
+		int fd{ -1 };
+		char* base{ nullptr };
+		size_t size{ 0 };			// mapped bytes
+	};
+
+	// opens or creates path with real blocks for at least minSize bytes (no sparse file, a full device
+	// would take SIGBUS) and maps it; existing is the file size before; false with errno set on error
+	NESESAPI bool MapLogSegment(const std::string& path, size_t minSize, LogMappedFile& seg, size_t& existing);
+	// unmaps and closes seg, the file is cut to used bytes if it was mapped; false when the cut failed
+	NESESAPI bool UnmapLogSegment(LogMappedFile& seg, size_t used);
+	// starts the write back of bytes [from, to) of seg, does not wait for it
+	NESESAPI void SyncLogSegment(const LogMappedFile& seg, size_t from, size_t to);
+	// false when files next to path cannot be preallocated (tmpfs / NFS / ...), reason says why
+	NESESAPI bool CanPreallocateLog(const std::string& path, std::string& reason);
+
+	class LogMmapSink : public LogSink
+	{
+	private:
+		static constexpr size_t defaultSegmentSize = 64 * 1024 * 1024;
+
+		LogFileName fileName_;
+		LogFlushPolicy policy_;
+		std::shared_ptr<LogRotator> rotator_;
+		std::string currentFile_;
+		size_t segmentSize_;
+		size_t mappedSize_{ 0 };				// size of the current segment, larger if an existing file was larger
+		size_t segmentIndex_{ 0 };
+		LogMappedFile segment_;
+		char* base_{ nullptr };
+		std::atomic<size_t> offset_{ 0 };		// committed bytes of the current segment
+		size_t synced_{ 0 };					// bytes handed to msync
+		int64_t firstDirty_{ 0 };				// monotonic ns of the oldest line not synced yet
+		uint64_t writeErrors_{ 0 };
+
+		// data end of a reused segment, a crashed process leaves the preallocated tail zeroed
+		static size_t UsedSize(const char* base, size_t size)
+		{
+			while (size > 0 && base[size - 1] == '\0')
+				size--;
+			return size;
+		}
+
+		bool MapSegment(const std::string& path)
+		{
+			size_t used = 0;
+			if (!MapLogSegment(path, segmentSize_, segment_, used)) return false;
+			base_ = segment_.base;
+			mappedSize_ = segment_.size;
+			used = UsedSize(base_, used);
+			offset_.store(used, std::memory_order_release);
+			synced_ = used;
+			return true;
+		}
+
+		// the segment file ends where the data ends
+		void UnmapSegment()
+		{
+			if (!UnmapLogSegment(segment_, offset_.load(std::memory_order_acquire)))
+				std::cerr << "Cannot truncate logfile " << currentFile_ << std::endl;
+			base_ = nullptr;
+			offset_.store(0, std::memory_order_release);
+			synced_ = 0;
+		}
+
+		// the segment is complete, unmapped and cut to size
+		void FinishSegment()
+		{
+			bool mapped = base_ != nullptr;
+			UnmapSegment();
+			if (mapped && rotator_)
+				rotator_->Finished(currentFile_);
+		}
+
+		// maps segment index_, moves to the next index while the files are full
+		bool OpenSegment()
+		{
+			for (int attempt = 0; attempt < 1024; attempt++)
+			{
+				currentFile_ = fileName_.Indexed(segmentIndex_);
+				if (currentFile_.empty()) return false;
+				if (!MapSegment(currentFile_))
+				{
+					std::cerr << "Cannot map logfile " << currentFile_ << " : " << std::strerror(errno) << std::endl;
+					UnmapSegment();
+					return false;
+				}
+				if (offset_.load(std::memory_order_relaxed) < mappedSize_)
+				{
+					if (rotator_)
+						rotator_->Opened(currentFile_);
+					return true;
+				}
+				FinishSegment();
+				segmentIndex_++;
+			}
+			return false;
+		}
+
+		void SyncDirty()
+		{
+			size_t end = offset_.load(std::memory_order_acquire);
+			if (!base_ || end <= synced_) return;
+			SyncLogSegment(segment_, synced_, end);
+			synced_ = end;
+		}
+
+	public:
+		explicit LogMmapSink(size_t segmentSize = defaultSegmentSize)
+			: LogSink("file"), segmentSize_(segmentSize < 64 * 1024 ? 64 * 1024 : segmentSize)
+		{
+		}
+
+		~LogMmapSink() override
+		{
+			Close();
+		}
+
+		// false when files next to path cannot be preallocated (tmpfs / NFS / ...), use LogFileSink there
+		static bool CanPreallocate(const std::string& path, std::string& reason)
+		{
+			return CanPreallocateLog(path, reason);
+		}
+
+		void SetPath(const std::string& path, const std::string& fileFormat)
+		{
+			UnmapSegment();
+			fileName_.Set(path, fileFormat);
+			currentFile_.clear();
+			segmentIndex_ = 0;
+		}
+
+		void SetPolicy(const LogFlushPolicy& policy) { policy_ = policy; }
+		void SetRotation(std::shared_ptr<LogRotator> rotator) { rotator_ = std::move(rotator); }
+		const LogFlushPolicy& GetPolicy() const { return policy_; }
+		const std::string& GetCurrentFile() const { return currentFile_; }
+		uint64_t WriteErrors() const { return writeErrors_; }
+		size_t Committed() const { return offset_.load(std::memory_order_acquire); }
+
+		void Append(std::string_view line, int64_t wallNs, bool isError = false)
+		{
+			if (fileName_.Update(wallNs))
+			{
+				FinishSegment();
+				segmentIndex_ = fileName_.WriteIndex();		// after the newest segment of the day, not the first with room
+			}
+			if (!base_ && !OpenSegment())
+			{
+				writeErrors_++;
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			size_t need = line.size() + 1;
+			size_t pos = offset_.load(std::memory_order_relaxed);
+			if (pos + need > mappedSize_ && pos > 0)
+			{
+				FinishSegment();
+				segmentIndex_++;
+				if (!OpenSegment())
+				{
+					writeErrors_++;
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				pos = offset_.load(std::memory_order_relaxed);
+			}
+			if (need > mappedSize_ - pos)
+			{
+				line = line.substr(0, mappedSize_ - pos - 1);		// longer than a whole segment
+				need = line.size() + 1;
+			}
+
+			if (synced_ == pos)
+				firstDirty_ = TimeService::MonotonicNs();
+			std::memcpy(base_ + pos, line.data(), line.size());
+			base_[pos + line.size()] = '\n';
+			offset_.store(pos + need, std::memory_order_release);
+
+			if (isError && policy_.flushOnError)
+				SyncDirty();
+			else if (offset_.load(std::memory_order_relaxed) - synced_ >= policy_.bytes)
+				SyncDirty();
+		}
+
+		void Write(const LogRecord& rec, std::string_view line) override
+		{
+			Append(line, rec.timestamp, rec.type == LogType::error);
+		}
+
+		void EndBatch() override
+		{
+			if (policy_.intervalMs <= 0)
+				Flush();
+			else
+				FlushIfDue();
+		}
+
+		void Flush() override
+		{
+			SyncDirty();
+		}
+
+		// same contract as LogFileSink::FlushIfDue
+		int64_t FlushIfDue() override
+		{
+			if (!base_ || offset_.load(std::memory_order_relaxed) <= synced_) return -1;
+			int64_t interval = static_cast<int64_t>(policy_.intervalMs) * 1000000;
+			int64_t elapsed = TimeService::MonotonicNs() - firstDirty_;
+			if (elapsed >= interval)
+			{
+				SyncDirty();
+				return -1;
+			}
+			return interval - elapsed;
+		}
+
+		void Close()
+		{
+			UnmapSegment();
+		}
+
+		void Stop() override { Close(); }
+	};
+}
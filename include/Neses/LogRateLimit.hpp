@@ -0,0 +1,139 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include "LogRecord.hpp"
+#include "TimeService.hpp"
+
+/*
+Rate limit of log storms, per call site.
+
+Each macro call site (its static LogCallsite, for NESESLOGF the format id) has a token bucket of
+burst records refilled at perSecond, explicit Logger::log(file, func, line, ...) calls share buckets
+hashed on file:line. A refused record is only counted, the logger thread writes
+"N messages suppressed by the rate limit" with the location of the call site once a second.
+Off by default, the producer check is then one relaxed load.
+
+	Logger::Instance().SetRateLimit(100, 20);		// 100 records / s per call site, bursts of 20
+*/
+
+namespace NESES
+{
+	constexpr size_t LogRateTableSize = 1024;		// buckets of calls without a LogCallsite
+
+	class LogRateLimiter
+	{
+	public:
+		// a call site with refused records
+		struct Suppressed
+		{
+			LogRateState* state;
+			const char* file;
+			const char* func;
+			int line;
+		};
+
+	private:
+		std::atomic<int64_t> intervalNs_{ 0 };		// ns per token, 0 is off
+		std::atomic<int64_t> burstNs_{ 0 };			// (burst - 1) * interval
+		LogRateState table_[LogRateTableSize];
+		std::vector<Suppressed> pending_;			// guarded by pendingLock
+		std::atomic<bool> hasPending_{ false };
+		std::mutex pendingLock;
+
+		LogRateLimiter() = default;
+
+		// GCRA form of the token bucket, one CAS per record
+		bool Take(LogRateState& state, int64_t interval)
+		{
+			int64_t now = TimeService::MonotonicNs();
+			int64_t burst = burstNs_.load(std::memory_order_relaxed);
+			int64_t tat = state.tat.load(std::memory_order_relaxed);
+			while (true)
+			{
+				int64_t start = tat > now ? tat : now;
+				if (start - now > burst) return false;
+				if (state.tat.compare_exchange_weak(tat, start + interval, std::memory_order_relaxed))
+					return true;
+			}
+		}
+
+		bool Allow(LogRateState& state, const char* file, const char* func, int line)
+		{
+			int64_t interval = intervalNs_.load(std::memory_order_relaxed);
+			if (interval == 0 || Take(state, interval)) return true;
+
+			// first refusal since the last report queues the call site once
+			if (state.suppressed.fetch_add(1, std::memory_order_relaxed) == 0)
+			{
+				std::lock_guard<std::mutex> lock(pendingLock);
+				pending_.push_back({ &state, file, func, line });
+				hasPending_.store(true, std::memory_order_release);
+			}
+			return false;
+		}
+
+	public:
+		LogRateLimiter(const LogRateLimiter&) = delete;
+		LogRateLimiter& operator=(const LogRateLimiter&) = delete;
+
+		static LogRateLimiter& Instance()
+		{
+			static LogRateLimiter instance;
+			return instance;
+		}
+
+		// perSecond 0 turns the limit off, burst records may come at once
+		void Set(double perSecond, uint32_t burst)
+		{
+			if (perSecond <= 0)
+			{
+				intervalNs_.store(0);
+				return;
+			}
+			int64_t interval = static_cast<int64_t>(1e9 / perSecond);
+			if (interval < 1) interval = 1;
+			burstNs_.store(static_cast<int64_t>(burst > 1 ? burst - 1 : 0) * interval);
+			intervalNs_.store(interval);
+		}
+
+		bool IsEnabled() const { return intervalNs_.load(std::memory_order_relaxed) != 0; }
+
+		bool Allow(const LogCallsite& callsite)
+		{
+			if (intervalNs_.load(std::memory_order_relaxed) == 0) return true;
+			return Allow(callsite.rate, callsite.file, callsite.func, callsite.line);
+		}
+
+		// calls with a location but no LogCallsite, file is compared by pointer (Logger keeps one per text)
+		bool Allow(const char* file, const char* func, int line)
+		{
+			if (intervalNs_.load(std::memory_order_relaxed) == 0) return true;
+			size_t hash = std::hash<const void*>()(file) ^ (static_cast<size_t>(line) * 0x9E3779B97F4A7C15ull);
+			return Allow(table_[hash % LogRateTableSize], file, func, line);
+		}
+
+		bool HasSuppressed() const { return hasPending_.load(std::memory_order_acquire); }
+
+		// call sites refused since the last call, with their counts (logger thread)
+		void TakeSuppressed(std::vector<std::pair<Suppressed, uint32_t>>& out)
+		{
+			std::vector<Suppressed> taken;
+			{
+				std::lock_guard<std::mutex> lock(pendingLock);
+				taken.swap(pending_);
+				hasPending_.store(false, std::memory_order_relaxed);
+			}
+			for (const auto& s : taken)
+			{
+				uint32_t count = s.state->suppressed.exchange(0, std::memory_order_relaxed);
+				if (count > 0)
+					out.emplace_back(s, count);
+			}
+		}
+	};
+}
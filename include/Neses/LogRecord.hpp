@@ -0,0 +1,370 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+#include <atomic>
+#include <type_traits>
+
+/*
+Fixed size log record, the producer side of the Logger.
+
+A record holds the raw values of a log call, formatting into text happens later on the consumer
+thread. For NESESLOGF the format string lives in a static LogCallsite per call site, its address is
+the format id, so the caller only copies a pointer, a timestamp and the argument bits.
+
+	NESESLOGF(LogType::info, "client {} connected in {} ms", clientId, elapsed);
+*/
+
+namespace NESES
+{
+	enum class LogType
+	{
+		info,
+		error,
+		warning,
+		userevent,
+		trace,
+		debug
+	};
+
+	// token bucket of one call site, see LogRateLimiter
+	struct LogRateState
+	{
+		std::atomic<int64_t> tat{ 0 };				// monotonic ns the bucket is full again
+		std::atomic<uint32_t> suppressed{ 0 };		// refused since the last report
+	};
+
+	// one static instance per log macro call site
+	struct LogCallsite
+	{
+		const char* format;		// "{}" placeholders, "{{" and "}}" for literal braces, nullptr for text macros
+		const char* file;
+		const char* func;
+		int line;
+		bool withLocation;		// print file : func : line like NESESDLOG
+		const char* tag;		// module tag for per module levels (NESES_LOG_TAG)
+
+		// effective level of the tag, refreshed when the level settings change (see LogLevels)
+		mutable std::atomic<uint32_t> levelEpoch{ 0 };
+		mutable std::atomic<int> minSeverity{ 0 };
+		mutable LogRateState rate{};
+	};
+
+	enum class LogArgType : uint8_t
+	{
+		i64,
+		u64,
+		f64,
+		boolean,
+		character,
+		str,
+		ptr
+	};
+
+	constexpr size_t LogRecordSize = 256;
+
+	struct LogRecord
+	{
+		static constexpr uint8_t flagTruncated = 0x01;
+		static constexpr size_t PayloadSize = 204;
+
+		int64_t timestamp;				// system clock, ns since epoch
+		const LogCallsite* callsite;	// format record, nullptr for text records
+		const char* file;				// text records with location, kept by the Logger until the end
+		const char* func;
+		std::string* longText;			// text not fitting the payload, owned by the record until Release
+		int32_t line;
+		LogType type;
+		uint16_t size;					// used payload bytes
+		uint8_t argCount;
+		uint8_t flags;
+		char payload[PayloadSize];		// text, or encoded arguments: [LogArgType][value]...
+
+		// header only, the payload is left as is
+		void Reset(LogType lt, int64_t ts)
+		{
+			timestamp = ts;
+			callsite = nullptr;
+			file = nullptr;
+			func = nullptr;
+			longText = nullptr;
+			line = 0;
+			type = lt;
+			size = 0;
+			argCount = 0;
+			flags = 0;
+		}
+
+		void Release()
+		{
+			delete longText;
+			longText = nullptr;
+		}
+
+		// text record, copied into the payload when it fits (no allocation)
+		void SetText(const char* text, size_t len)
+		{
+			if (len <= PayloadSize)
+			{
+				std::memcpy(payload, text, len);
+				size = static_cast<uint16_t>(len);
+			}
+			else
+			{
+				longText = new std::string(text, len);
+				size = 0;
+			}
+		}
+
+		std::string_view Text() const
+		{
+			if (longText) return std::string_view(*longText);
+			return std::string_view(payload, size);
+		}
+
+		template <typename T>
+		void Append(const T& value)
+		{
+			using D = std::decay_t<T>;
+			if constexpr (std::is_same_v<D, bool>)
+				PutScalar(LogArgType::boolean, static_cast<uint8_t>(value ? 1 : 0));
+			else if constexpr (std::is_same_v<D, char>)
+				PutScalar(LogArgType::character, value);
+			else if constexpr (std::is_enum_v<D>)
+				Append(static_cast<std::underlying_type_t<D>>(value));
+			else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>)
+				PutScalar(LogArgType::i64, static_cast<int64_t>(value));
+			else if constexpr (std::is_integral_v<D>)
+				PutScalar(LogArgType::u64, static_cast<uint64_t>(value));
+			else if constexpr (std::is_floating_point_v<D>)
+				PutScalar(LogArgType::f64, static_cast<double>(value));
+			else if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>)
+				PutString(value ? std::string_view(value) : std::string_view("(null)"));
+			else if constexpr (std::is_convertible_v<const D&, std::string_view>)
+				PutString(std::string_view(value));
+			else if constexpr (std::is_pointer_v<D>)
+				PutScalar(LogArgType::ptr, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+			else
+				static_assert(sizeof(D) == 0, "type cannot be captured into a log record, convert it to string or number");
+		}
+
+	private:
+		template <typename V>
+		void PutScalar(LogArgType at, V value)
+		{
+			if (size + 1 + sizeof(V) > PayloadSize)
+			{
+				flags |= flagTruncated;
+				return;
+			}
+			payload[size] = static_cast<char>(at);
+			std::memcpy(payload + size + 1, &value, sizeof(V));
+			size = static_cast<uint16_t>(size + 1 + sizeof(V));
+			argCount++;
+		}
+
+		// [str][uint16 length][bytes], cut to the space left
+		void PutString(std::string_view sv)
+		{
+			constexpr size_t head = 1 + sizeof(uint16_t);
+			if (size + head > PayloadSize)
+			{
+				flags |= flagTruncated;
+				return;
+			}
+			size_t room = PayloadSize - size - head;
+			uint16_t len = static_cast<uint16_t>(sv.size() < room ? sv.size() : room);
+			if (len < sv.size())
+				flags |= flagTruncated;
+			payload[size] = static_cast<char>(LogArgType::str);
+			std::memcpy(payload + size + 1, &len, sizeof(len));
+			std::memcpy(payload + size + head, sv.data(), len);
+			size = static_cast<uint16_t>(size + head + len);
+			argCount++;
+		}
+	};
+
+	static_assert(sizeof(LogRecord) == LogRecordSize, "LogRecord layout changed");
+	static_assert(std::is_trivially_copyable_v<LogRecord>, "LogRecord must stay trivially copyable");
+
+	// walks the encoded arguments of a format record
+	class LogArgReader
+	{
+	private:
+		const LogRecord& rec_;
+		size_t pos_{ 0 };
+
+	public:
+		explicit LogArgReader(const LogRecord& rec) : rec_(rec) {}
+
+		bool AtEnd() const { return pos_ >= rec_.size; }
+
+		// appends the text of the next argument, false when there is none left
+		template <typename Out>
+		bool Next(Out& out)
+		{
+			if (AtEnd()) return false;
+			const char* p = rec_.payload + pos_;
+			LogArgType at = static_cast<LogArgType>(*p++);
+			char buf[32];
+			switch (at)
+			{
+			case LogArgType::i64:
+			{
+				int64_t v;
+				std::memcpy(&v, p, sizeof(v));
+				auto res = std::to_chars(buf, buf + sizeof(buf), v);
+				out.append(buf, static_cast<size_t>(res.ptr - buf));
+				pos_ += 1 + sizeof(v);
+				break;
+			}
+			case LogArgType::u64:
+			{
+				uint64_t v;
+				std::memcpy(&v, p, sizeof(v));
+				auto res = std::to_chars(buf, buf + sizeof(buf), v);
+				out.append(buf, static_cast<size_t>(res.ptr - buf));
+				pos_ += 1 + sizeof(v);
+				break;
+			}
+			case LogArgType::f64:
+			{
+				double v;
+				std::memcpy(&v, p, sizeof(v));
+				auto res = std::to_chars(buf, buf + sizeof(buf), v);
+				out.append(buf, static_cast<size_t>(res.ptr - buf));
+				pos_ += 1 + sizeof(v);
+				break;
+			}
+			case LogArgType::ptr:
+			{
+				uint64_t v;
+				std::memcpy(&v, p, sizeof(v));
+				buf[0] = '0';
+				buf[1] = 'x';
+				auto res = std::to_chars(buf + 2, buf + sizeof(buf), v, 16);
+				out.append(buf, static_cast<size_t>(res.ptr - buf));
+				pos_ += 1 + sizeof(v);
+				break;
+			}
+			case LogArgType::boolean:
+			{
+				if (*p)
+					out.append("true", 4);
+				else
+					out.append("false", 5);
+				pos_ += 2;
+				break;
+			}
+			case LogArgType::character:
+			{
+				out.append(p, 1);
+				pos_ += 2;
+				break;
+			}
+			case LogArgType::str:
+			{
+				uint16_t len;
+				std::memcpy(&len, p, sizeof(len));
+				out.append(p + sizeof(len), len);
+				pos_ += 1 + sizeof(len) + len;
+				break;
+			}
+			default:
+				pos_ = rec_.size;	// corrupt record, stop here
+				return false;
+			}
+			return true;
+		}
+	};
+
+	// message part of a record, Out needs append(const char*, size_t) (std::string does)
+	template <typename Out>
+	void FormatLogMessage(const LogRecord& rec, Out& out)
+	{
+		if (!rec.callsite || !rec.callsite->format)
+		{
+			std::string_view text = rec.Text();
+			out.append(text.data(), text.size());
+			return;
+		}
+
+		LogArgReader args(rec);
+		const char* f = rec.callsite->format;
+		const char* lit = f;
+		while (*f)
+		{
+			if ((f[0] == '{' && f[1] == '{') || (f[0] == '}' && f[1] == '}'))
+			{
+				out.append(lit, static_cast<size_t>(f - lit) + 1);
+				f += 2;
+				lit = f;
+			}
+			else if (f[0] == '{' && f[1] == '}')
+			{
+				out.append(lit, static_cast<size_t>(f - lit));
+				if (!args.Next(out))
+					out.append("{}", 2);
+				f += 2;
+				lit = f;
+			}
+			else
+			{
+				f++;
+			}
+		}
+		out.append(lit, static_cast<size_t>(f - lit));
+
+		// more arguments than placeholders, keep them visible
+		while (!args.AtEnd())
+		{
+			out.append(" ", 1);
+			if (!args.Next(out)) break;
+		}
+		if (rec.flags & LogRecord::flagTruncated)
+			out.append("...", 3);
+	}
+
+	inline const char* LogTypeName(LogType lt)
+	{
+		switch (lt)
+		{
+		case LogType::error: return "ERROR";
+		case LogType::warning: return "WARNING";
+		case LogType::userevent: return "USEREVENT";
+		case LogType::trace: return "TRACE";
+		case LogType::debug: return "DEBUG";
+		case LogType::info:
+		default: return "INFO";
+		}
+	}
+
+	// whole text line of a record: time : TYPE : [file : func : line : ] message
+	template <typename Out>
+	void FormatLogLine(const LogRecord& rec, std::string_view timeText, Out& out)
+	{
+		const char* type = LogTypeName(rec.type);
+		out.append(timeText.data(), timeText.size());
+		out.append(" : ", 3);
+		out.append(type, std::strlen(type));
+		out.append(" : ", 3);
+
+		const char* file = rec.callsite ? (rec.callsite->withLocation ? rec.callsite->file : nullptr) : rec.file;
+		if (file)
+		{
+			const char* func = rec.callsite ? rec.callsite->func : rec.func;
+			char buf[16];
+			auto res = std::to_chars(buf, buf + sizeof(buf), rec.callsite ? rec.callsite->line : rec.line);
+			out.append(file, std::strlen(file));
+			out.append(" : ", 3);
+			if (func)
+				out.append(func, std::strlen(func));
+			out.append(" : ", 3);
+			out.append(buf, static_cast<size_t>(res.ptr - buf));
+			out.append(" : ", 3);
+		}
+		FormatLogMessage(rec, out);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <iostream>
+#include <memory>
+#include <string>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include "LogSink.hpp"
+#include "TcpSyncClient.hpp"
+
+/*
+Log shipping. Batches of lines go to a transport function on the io lane, a failed batch is retried a
+few times and then dropped (counted in Dropped), the logger thread never waits for the network.
+TcpTransport sends each batch with a TcpSyncClient and waits for the collector's acknowledgement,
+any reply ending with the read delimiter of the context.
+*/
+
+namespace NESES
+{
+	class LogRemoteSink : public LogAsyncSink
+	{
+	public:
+		// true if the batch was delivered, lines are '\n' terminated
+		using Transport = std::function<bool(const std::string& batch)>;
+
+	private:
+		Transport send_;
+		int retries_;
+		std::chrono::milliseconds retryWait_;
+
+	protected:
+		void Output(const LogLineBatch& batch) override
+		{
+			for (int attempt = 0; send_; attempt++)
+			{
+				if (send_(batch.text)) return;
+				if (attempt >= retries_) break;
+				std::this_thread::sleep_for(retryWait_ * (attempt + 1));
+			}
+			dropped_.fetch_add(batch.Count(), std::memory_order_relaxed);
+		}
+
+	public:
+		explicit LogRemoteSink(Transport send, int retries = 2, std::chrono::milliseconds retryWait = std::chrono::milliseconds(200),
+			size_t maxBatches = 16, const std::string& name = "remote")
+			: LogAsyncSink(name, maxBatches), send_(std::move(send)), retries_(retries < 0 ? 0 : retries), retryWait_(retryWait)
+		{
+		}
+
+		// nullptr if the context is not valid, the connection is made on the first batch
+		static Transport TcpTransport(const TcpClientContext& cc)
+		{
+			auto client = std::make_shared<TcpSyncClient>();
+			BackObject back;
+			client->Set(cc, back);
+			if (!back.Success)
+			{
+				std::cerr << "Remote log sink not set : " << back.ErrDesc << std::endl;
+				return nullptr;
+			}
+			return [client](const std::string& batch)
+				{
+					BackObject back;
+					std::string ack;
+					client->Send(batch, ack, back);
+					if (!back.Success)
+						client->DisConnect();		// reconnect on the next batch
+					return back.Success;
+				};
+		}
+	};
+}
@@ -0,0 +1,288 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <charconv>
+#include <chrono>
+#include "LogRecord.hpp"
+#include "LogLevel.hpp"
+#include "App.hpp"
+
+/*
+Outputs of the Logger. The logger thread formats a record once and hands it to every sink whose level
+accepts it. Synchronous sinks (the log files) write on the logger thread; LogAsyncSink based sinks
+(console, handler, remote) only collect the lines into a batch there and write it on their own
+executor lane, so a blocked stdout or a slow handler stalls only itself. A sink that cannot keep up drops whole
+batches and counts them.
+
+	auto remote = std::make_shared<LogRemoteSink>(LogRemoteSink::TcpTransport(ctx));
+	remote->SetLevel(LogType::warning);
+	Logger::Instance().AddSink(remote);		// before Init
+*/
+
+namespace NESES
+{
+	class LogSink
+	{
+	private:
+		std::string name_;
+		std::atomic<int> minSeverity_{ NESES_LOG_LEVEL_TRACE };
+
+	protected:
+		std::atomic<uint64_t> dropped_{ 0 };
+
+	public:
+		explicit LogSink(const std::string& name) : name_(name) {}
+		virtual ~LogSink() = default;
+
+		LogSink(const LogSink&) = delete;
+		LogSink& operator=(const LogSink&) = delete;
+
+		const std::string& Name() const { return name_; }
+
+		// on top of the global / tag levels, records below it are not given to this sink
+		void SetLevel(LogType lt) { minSeverity_.store(LogSeverity(lt), std::memory_order_relaxed); }
+		bool Accepts(LogType lt) const { return LogSeverity(lt) >= minSeverity_.load(std::memory_order_relaxed); }
+
+		// lines this sink could not write
+		uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+		// false if the sink works on the raw record only (binary file), the logger skips formatting for it
+		virtual bool NeedsText() const { return true; }
+
+		// logger thread from here on
+		virtual void Start() {}
+
+		// line is the formatted text of rec, empty if NeedsText is false for every sink
+		virtual void Write(const LogRecord& rec, std::string_view line) = 0;
+
+		// end of a batch of records
+		virtual void EndBatch() {}
+
+		// ns until the sink wants FlushIfDue again, -1 nothing waiting
+		virtual int64_t FlushIfDue() { return -1; }
+
+		// everything written so far goes out now
+		virtual void Flush() {}
+
+		// after the last record, the logger thread has finished
+		virtual void Stop() { Flush(); }
+	};
+
+	// lines handed from the logger thread to a sink thread
+	struct LogLineBatch
+	{
+		std::string text;				// lines, each '\n' terminated
+		std::vector<size_t> ends;		// offset of the '\n' of each line
+
+		void Add(std::string_view line)
+		{
+			text.append(line.data(), line.size());
+			ends.push_back(text.size());
+			text.push_back('\n');
+		}
+
+		std::string_view Line(size_t i) const
+		{
+			size_t begin = i == 0 ? 0 : ends[i - 1] + 1;
+			return std::string_view(text).substr(begin, ends[i] - begin);
+		}
+
+		size_t Count() const { return ends.size(); }
+		bool Empty() const { return ends.empty(); }
+
+		void Clear()
+		{
+			text.clear();
+			ends.clear();
+		}
+	};
+
+	/*
+	Sink written off the logger thread. The logger thread appends to the current batch and hands it over
+	at the end of each logger batch, on an error line or when it is batchBytes long; a drain job writes
+	the queued batches on the "log-<name>" executor lane, one worker added for the sink on Start.
+	At most maxBatches wait, a full queue drops the new batch and the next batch reports it.
+	Keep it in a shared_ptr, the drain job holds one.
+	*/
+	class LogAsyncSink : public LogSink, public std::enable_shared_from_this<LogAsyncSink>
+	{
+	private:
+		size_t maxBatches_;
+		size_t batchBytes_;
+		LogLineBatch current_;					// logger thread
+		uint64_t unreported_{ 0 };				// logger thread, dropped lines not reported yet
+		std::deque<LogLineBatch> queue_;		// guarded by queueLock
+		std::vector<LogLineBatch> free_;		// emptied batches for reuse, guarded by queueLock
+		bool scheduled_{ false };				// drain job queued or running, guarded by queueLock
+		std::string lane_;
+		std::mutex queueLock;
+		std::condition_variable idleCv;			// drain job finished
+
+		void ScheduleLocked()
+		{
+			if (scheduled_ || queue_.empty()) return;
+			auto self = shared_from_this();
+			auto& executor = App::Instance().GetExecutor(lane_);
+			auto task = executor.GetNew("log-" + Name(), [self]() { self->Drain(); return BackObject(); });
+			scheduled_ = task && executor.Enqueue(task);	// refused, the next handoff tries again
+		}
+
+		// sink lane, one job at a time
+		void Drain()
+		{
+			LogLineBatch batch;
+			std::unique_lock<std::mutex> lock(queueLock);
+			while (!queue_.empty())
+			{
+				batch = std::move(queue_.front());
+				queue_.pop_front();
+				lock.unlock();
+				OutputSafe(batch);
+				batch.Clear();
+				lock.lock();
+				if (free_.size() < maxBatches_)
+					free_.push_back(std::move(batch));
+			}
+			scheduled_ = false;
+			idleCv.notify_all();
+		}
+
+		void OutputSafe(const LogLineBatch& batch)
+		{
+			try
+			{
+				Output(batch);
+			}
+			catch (const std::exception& e)
+			{
+				dropped_.fetch_add(batch.Count(), std::memory_order_relaxed);
+				std::cerr << "Log sink " << Name() << " error : " << e.what() << std::endl;
+			}
+		}
+
+		void Handoff()
+		{
+			if (current_.Empty()) return;
+			if (unreported_ > 0)
+			{
+				char buf[32];
+				auto res = std::to_chars(buf, buf + sizeof(buf), unreported_);
+				std::string line(buf, res.ptr);
+				current_.Add(line.append(" messages dropped by sink ").append(Name()));
+				unreported_ = 0;
+			}
+
+			std::lock_guard<std::mutex> lock(queueLock);
+			if (queue_.size() >= maxBatches_)
+			{
+				dropped_.fetch_add(current_.Count(), std::memory_order_relaxed);
+				unreported_ += current_.Count();
+				current_.Clear();
+				ScheduleLocked();
+				return;
+			}
+			queue_.push_back(std::move(current_));
+			current_ = LogLineBatch();
+			if (!free_.empty())
+			{
+				current_ = std::move(free_.back());
+				free_.pop_back();
+			}
+			ScheduleLocked();
+		}
+
+	protected:
+		// sink lane, writes one batch
+		virtual void Output(const LogLineBatch& batch) = 0;
+
+	public:
+		LogAsyncSink(const std::string& name, size_t maxBatches = 64, size_t batchBytes = 64 * 1024)
+			: LogSink(name), maxBatches_(maxBatches == 0 ? 1 : maxBatches), batchBytes_(batchBytes), lane_("log-" + name)
+		{
+		}
+
+		// sinks of the same name share the lane, AddExecutor refuses the second one
+		void Start() override
+		{
+			App::Instance().AddExecutor(lane_, 1, 4);
+		}
+
+		void Write(const LogRecord& rec, std::string_view line) override
+		{
+			current_.Add(line);
+			if (current_.text.size() >= batchBytes_ || rec.type == LogType::error)
+				Handoff();
+		}
+
+		void EndBatch() override { Handoff(); }
+		void Flush() override { Handoff(); }
+
+		// waits for the queued batches, written here if no drain job could be queued
+		void Stop() override
+		{
+			Handoff();
+			{
+				std::unique_lock<std::mutex> lock(queueLock);
+				if (!idleCv.wait_for(lock, std::chrono::seconds(10), [this]() { return !scheduled_; }))
+				{
+					// stuck output, the batch being written is the last one
+					size_t lines = 0;
+					for (const auto& batch : queue_)
+						lines += batch.Count();
+					queue_.clear();
+					dropped_.fetch_add(lines, std::memory_order_relaxed);
+					std::cerr << "Log sink " << Name() << " did not finish writing, " << lines << " lines dropped" << std::endl;
+					return;		// the job keeps the sink alive
+				}
+				if (queue_.empty()) return;
+				scheduled_ = true;
+			}
+			Drain();
+		}
+	};
+
+	class LogConsoleSink : public LogAsyncSink
+	{
+	protected:
+		void Output(const LogLineBatch& batch) override
+		{
+			std::cout.write(batch.text.data(), static_cast<std::streamsize>(batch.text.size()));
+			std::cout.flush();
+		}
+
+	public:
+		LogConsoleSink() : LogAsyncSink("console") {}
+	};
+
+	// user function per line, the handler of Logger::Init or any callback
+	class LogHandlerSink : public LogAsyncSink
+	{
+	private:
+		std::function<void(const std::string&)> handler_;
+		std::string line_;		// sink thread
+
+	protected:
+		void Output(const LogLineBatch& batch) override
+		{
+			for (size_t i = 0; i < batch.Count(); i++)
+			{
+				line_.assign(batch.Line(i));
+				handler_(line_);
+			}
+		}
+
+	public:
+		explicit LogHandlerSink(std::function<void(const std::string&)> handler, const std::string& name = "handler")
+			: LogAsyncSink(name), handler_(std::move(handler))
+		{
+		}
+	};
+}
@@ -11,6 +11,9 @@
 
 namespace NESES
 {
+    template<typename ReturnType>
+    class TaskStrand;
+
     /**
      * @brief Simple thread pool + job queue.
      *
@@ -109,16 +112,41 @@ namespace NESES
             }
         }
 
+        /**
+         * @brief Enqueue without the maxTaskCount_ check.
+         *
+         * Used by TaskStrand for its drain tasks: a strand has at most one drain task in the queue
+         * and bounds its own backlog, so counting it against the user queue limit could strand work.
+         *
+         * @return true if task accepted, false if invalid or pool is stopping.
+         */
+        bool EnqueueInternal(std::shared_ptr<NesesTask<ReturnType>> task)
+        {
+            if (!task || !task->IsValid()) return false;
+            if (stopFlag.load()) return false;
+
+            CreateWorker();
+            {
+                std::unique_lock<std::mutex> lock(taskQueueLock);
+                tasks.push_back(std::move(task));
+            }
+            cv.notify_one();
+            return true;
+        }
+
     public:
 
         /**
          * @brief Construct a TaskPool.
          *
-         * Sets `maxWorkerCount_` from std::thread::hardware_concurrency() with a fallback to 1,
-         * and reserves the worker vector to avoid reallocation.
+         * Sets `maxWorkerCount_` from `maxworkercount`, or from std::thread::hardware_concurrency()
+         * when it is 0, with a fallback to 1, and reserves the worker vector to avoid reallocation.
+         *
+         * @param maxtaskcount Maximum number of queued tasks.
+         * @param maxworkercount Maximum number of worker threads, 0 for one per core.
          */
-        TaskPool(const size_t maxtaskcount)
-            :maxWorkerCount_(std::thread::hardware_concurrency())
+        TaskPool(const size_t maxtaskcount, const size_t maxworkercount = 0)
+            :maxWorkerCount_(maxworkercount == 0 ? std::thread::hardware_concurrency() : maxworkercount)
             ,maxTaskCount_(maxtaskcount)
         {
             if (maxWorkerCount_ == 0) maxWorkerCount_ = 1;
@@ -168,6 +196,25 @@ namespace NESES
             return back;
         }
 
+        /**
+         * @brief Create a strand (serial executor) running on this pool.
+         *
+         * Tasks posted to the strand run in FIFO order and never concurrently with each other,
+         * on whichever pool worker is free.
+         *
+         * @param name Strand name.
+         * @param maxtaskcount Maximum number of tasks queued on the strand, 0 uses the pool limit.
+         * @return shared_ptr to a new TaskStrand or nullptr if pool is stopping.
+         *
+         * @note Include "TaskStrand.hpp" to use this member.
+         */
+        std::shared_ptr<TaskStrand<ReturnType>> NewStrand(const std::string& name, size_t maxtaskcount = 0)
+        {
+            if (stopFlag.load()) return nullptr;
+            if (maxtaskcount == 0) maxtaskcount = maxTaskCount_;
+            return std::shared_ptr<TaskStrand<ReturnType>>(new TaskStrand<ReturnType>(*this, name, maxtaskcount));
+        }
+
         /**
          * @brief Enqueue a task for execution.
          *
@@ -227,6 +274,22 @@ namespace NESES
             }
         }
 
+        /**
+         * @brief Maximum number of worker threads.
+         */
+        size_t maxWorkerCount() const
+        {
+            return maxWorkerCount_;
+        }
+
+        /**
+         * @brief Maximum number of queued tasks.
+         */
+        size_t maxTaskCount() const
+        {
+            return maxTaskCount_;
+        }
+
         /**
          * @brief Current number of worker threads stored.
          * @return worker count (protected by workerVectorLock).
@@ -247,5 +310,7 @@ namespace NESES
             return tasks.size();
         }
 
+        template<typename T>
+        friend class TaskStrand;
     };
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#pragma once
+#include <iostream>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include "NesesTask.hpp"
+#include "TaskPool.hpp"
+
+namespace NESES
+{
+    /**
+     * @brief Serial executor multiplexed onto a shared TaskPool.
+     *
+     * @tparam ReturnType Task return type, must match the owning TaskPool.
+     *
+     * @remarks
+     * A strand guarantees that the tasks posted to it run one at a time and in FIFO order,
+     * while the actual work is done by the pool's worker threads. Any number of strands
+     * can share the same pool, so ordered per-key processing (per directory, per connection, ...)
+     * no longer needs a dedicated NesesThread.
+     *
+     * Scheduling summary:
+     * - Posted tasks are kept in the strand's own bounded queue.
+     * - At most one drain task per strand is queued on or running in the pool (`scheduled_`).
+     * - The drain task runs up to `maxBatch` tasks, then re-queues itself so other strands get a turn.
+     *
+     * Thread-safety summary:
+     * - `strandLock` protects `tasks` and `scheduled_`.
+     * - `stopFlag` is atomic and used to reject new tasks after Stop() or once the pool refused a drain task.
+     */
+    template<typename ReturnType>
+    class TaskStrand : public std::enable_shared_from_this<TaskStrand<ReturnType>>
+    {
+    private:
+        static constexpr size_t maxBatch = 16;                      /**< tasks executed per pool turn */
+
+        TaskPool<ReturnType>& pool_;                                /**< pool the strand runs on */
+        std::string name_;                                          /**< human-readable strand name */
+        size_t maxTaskCount_;                                       /**< maximum number of queued tasks */
+        std::deque<std::shared_ptr<NesesTask<ReturnType>>> tasks;   /**< pending tasks in FIFO order */
+        mutable std::mutex strandLock;                              /**< mutex protecting tasks and scheduled_ */
+        bool scheduled_{ false };                                   /**< a drain task is queued or running */
+        std::atomic<bool> stopFlag{ false };                        /**< strand shutdown flag */
+
+        /**
+         * @brief Construct a strand bound to a pool.
+         *
+         * @note This constructor is private; TaskPool is declared a friend and creates strands.
+         */
+        TaskStrand(TaskPool<ReturnType>& pool, const std::string& name, size_t maxtaskcount)
+            : pool_(pool), name_(name), maxTaskCount_(maxtaskcount)
+        {
+        }
+
+        /**
+         * @brief Queue a drain task on the pool.
+         * @return false if the pool refused the task (pool is stopping).
+         */
+        bool Schedule()
+        {
+            auto self = this->shared_from_this();
+            auto drain = pool_.GetNew("strand-" + name_, [self]() { self->Drain(); return ReturnType(); });
+            return pool_.EnqueueInternal(drain);
+        }
+
+        /**
+         * @brief Pool-side loop: run queued tasks one by one.
+         *
+         * Runs at most `maxBatch` tasks per turn and re-queues itself if work remains.
+         * If the pool refuses the continuation the remaining tasks are drained inline,
+         * so a strand never ends up with queued tasks and no drain task.
+         */
+        void Drain()
+        {
+            while (true)
+            {
+                for (size_t n = 0; n < maxBatch; n++)
+                {
+                    std::shared_ptr<NesesTask<ReturnType>> task{ nullptr };
+                    {
+                        std::lock_guard<std::mutex> lock(strandLock);
+                        if (tasks.empty())
+                        {
+                            scheduled_ = false;
+                            return;
+                        }
+                        task = tasks.front();
+                        tasks.pop_front();
+                    }
+
+                    try
+                    {
+                        (*task)();
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::cerr << "Strand task execution error: " << e.what() << std::endl;
+                    }
+                    catch (...)
+                    {
+                        std::cerr << "Unknown error during strand task execution!" << std::endl;
+                    }
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(strandLock);
+                    if (tasks.empty())
+                    {
+                        scheduled_ = false;
+                        return;
+                    }
+                }
+
+                // yield the worker to other strands / tasks
+                if (Schedule())
+                    return;
+            }
+        }
+
+    public:
+
+        TaskStrand(const TaskStrand&) = delete;
+        TaskStrand& operator =(const TaskStrand&) = delete;
+
+        /**
+         * @brief Post a task to the strand.
+         *
+         * The task runs after every task posted before it has finished, never concurrently with them.
+         *
+         * @param task Shared pointer to a configured NesesTask (must be Set()).
+         * @return true if task accepted, false if invalid, strand/pool stopping or strand queue full.
+         *
+         * @note As with TaskPool::Enqueue, get the task future before posting if you need it.
+         */
+        bool Post(std::shared_ptr<NesesTask<ReturnType>> task)
+        {
+            if (!task || !task->IsValid()) return false;
+            if (stopFlag.load()) return false;
+
+            bool schedule = false;
+            {
+                std::lock_guard<std::mutex> lock(strandLock);
+                if (tasks.size() >= maxTaskCount_) return false;
+                tasks.push_back(task);
+                if (!scheduled_)
+                {
+                    scheduled_ = true;
+                    schedule = true;
+                }
+            }
+
+            if (schedule && !Schedule())
+            {
+                // pool is stopping: refuse this task and every later one, as Stop() does. Tasks other
+                // threads posted meanwhile were already accepted, they are drained inline here.
+                Stop();
+                {
+                    std::lock_guard<std::mutex> lock(strandLock);
+                    auto it = std::find(tasks.begin(), tasks.end(), task);
+                    if (it != tasks.end())
+                        tasks.erase(it);
+                }
+                Drain();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Create a named task on the owning pool and post it.
+         *
+         * @return shared_ptr to the posted task, or nullptr if it was not accepted.
+         */
+        template <typename Func, typename... Args>
+        std::shared_ptr<NesesTask<ReturnType>> Post(const std::string& name, Func&& func, Args&&... args)
+        {
+            auto task = pool_.GetNew(name, std::forward<Func>(func), std::forward<Args>(args)...);
+            if (!task || !Post(task)) return nullptr;
+            return task;
+        }
+
+        /**
+         * @brief Reject new tasks and request cooperative cancellation of the queued ones.
+         *
+         * Already queued tasks still run (in order) so their futures are satisfied;
+         * they should check `GetStopFlag()` and return promptly.
+         */
+        void Stop()
+        {
+            stopFlag.store(true);
+            std::lock_guard<std::mutex> lock(strandLock);
+            for (auto& t : tasks)
+                t->SetStopFlag(true);
+        }
+
+        /**
+         * @brief Get the strand name.
+         */
+        const std::string& GetName() const
+        {
+            return name_;
+        }
+
+        /**
+         * @brief Current queued task count (running task excluded).
+         */
+        size_t taskCount() const
+        {
+            std::lock_guard<std::mutex> lock(strandLock);
+            return tasks.size();
+        }
+
+        /**
+         * @brief True after Stop() or once the pool is stopping; Post is refused from then on.
+         */
+        bool IsStopped() const
+        {
+            return stopFlag.load() || pool_.stopFlag.load();
+        }
+
+        /**
+         * @brief True when nothing is queued and no drain task is pending on the pool.
+         */
+        bool IsIdle() const
+        {
+            std::lock_guard<std::mutex> lock(strandLock);
+            return !scheduled_ && tasks.empty();
+        }
+
+        template<typename T>
+        friend class TaskPool;
+    };
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "Exporter.h"
+
+namespace NESES
+{
+	// Shared network reactor: one io_context run by N threads.
+	// TcpAsyncClient instances constructed with a reactor register with it and run their
+	// handlers on it (serialized per client by the client's own strand) instead of
+	// owning an io_context and a service thread each.
+	class NESESAPI TcpReactor
+	{
+	private:
+		struct TRImp;
+		std::unique_ptr<TRImp> pimpl;
+
+		size_t threadCount_;
+		std::vector<std::thread> threads_;
+		std::mutex reactorLock;
+		std::atomic<bool> isStarted{ false };
+		std::atomic<size_t> clientCount{ 0 };
+
+		void RunLoop();
+		void StopThreads();		// under reactorLock
+		void Register();
+		void Unregister();
+
+	public:
+		TcpReactor(const TcpReactor&) = delete;
+		TcpReactor& operator=(const TcpReactor&) = delete;
+
+		// threadcount 0 means one thread per core
+		TcpReactor(size_t threadcount = 0);
+		~TcpReactor();
+
+		void Start();
+		// refused while clients are registered, destroy them first
+		void Stop();
+		bool IsStarted() const;
+		size_t GetThreadCount() const;
+		size_t GetClientCount() const;
+
+		friend class TcpAsyncClient;
+	};
+}